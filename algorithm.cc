@@ -22,38 +22,73 @@
  */
 
 #include "hex.h"
+#include "internal.h"
 
 #include <algorithm>
 #include <cassert>
+#include <iterator>
+#include <limits>
+#include <pthread.h>
 #include <sstream>
+#include <vector>
 
 namespace hex {
 
 
+namespace {
+#ifdef HEX_PARANOID_CHECKS
+  bool paranoid =true;
+#else
+  bool paranoid =false;
+#endif
+}
+
+
+bool
+paranoid_checks(void)
+{
+#ifdef HEX_PARANOID_CHECKS
+  return paranoid;
+#else
+  return false;
+#endif
+}
+
+
+void
+set_paranoid_checks(bool on)
+{
+  paranoid = on;
+}
+
+
+/** Helper: v, clamped to the range of int. A co-ordinate that needs to be
+ *  clamped is off every grid, and stays off it. */
+inline int
+clamp_int(long long v)
+{
+  if(v > std::numeric_limits<int>::max())
+      return std::numeric_limits<int>::max();
+  if(v < std::numeric_limits<int>::min())
+      return std::numeric_limits<int>::min();
+  return int(v);
+}
+
+
 void
 go(int& i, int& j, Direction d, size_t distance)
 {
-  for(; distance>0; --distance)
-      if(j%2)
-          switch(d) // odd
-          {
-            case A: ++i;      break;
-            case B: ++i; ++j; break;
-            case C:      ++j; break;
-            case D: --i;      break;
-            case E:      --j; break;
-            case F: ++i; --j; break;
-          }
-      else
-          switch(d) // even
-          {
-            case A: ++i;      break;
-            case B:      ++j; break;
-            case C: --i; ++j; break;
-            case D: --i;      break;
-            case E: --i; --j; break;
-            case F:      --j; break;
-          }
+  // Axial vector of each direction.
+  static const int dq[DIRECTIONS] ={ 1, 0,-1,-1, 0, 1 };
+  static const int dr[DIRECTIONS] ={ 0, 1, 1, 0,-1,-1 };
+  // No grid is 2^32 hexes across, so longer moves can be cut short.
+  const long long n =static_cast<long long>(
+      std::min<unsigned long long>( distance, 1ULL<<33 )
+    );
+  const long long q =axial_q(i,j) + dq[d] * n;
+  const long long r =j + dr[d] * n;
+  j = clamp_int(r);
+  i = clamp_int( q + (r - (r&1)) / 2 ); // offset_i(q,r), without overflow.
 }
 
 
@@ -107,40 +142,15 @@ steps(const Hex* from, const Hex* to)
 size_t
 distance(const Hex* from, const Hex* to)
 {
-  return steps(from,to).size();
+  return distance(from->i,from->j,to->i,to->j);
 }
 
 
 std::set<Hex*>
 range(Hex* h, size_t distance)
 {
-  std::set<Hex*> result;
-  if(distance<1)
-  {
-    result.insert(h);
-  }
-  else
-  {
-    const Grid& grid =h->grid();
-    int i =h->i;
-    int j =h->j;
-  
-    try {
-      go(i,j,hex::A,distance); // in/out: i,j
-      result.insert( grid.hex(i,j) );
-    } catch(hex::out_of_range&) {}
-  
-    for(int d=0; d<DIRECTIONS; ++d)
-    {
-      Direction direction =C+d;
-      for(size_t count=0; count<distance; ++count)
-          try {
-            go(i,j,direction); // in/out: i,j
-            result.insert( grid.hex(i,j) );
-          } catch(hex::out_of_range&) {}
-    }
-  }
-  return result;
+  const Spiral r =ring(h,distance);
+  return std::set<Hex*>(r.begin(),r.end());
 }
 
 
@@ -183,6 +193,118 @@ set_union(const std::set<Hex*>& a, const std::set<Hex*>& b)
 }
 
 
+HexSet
+set_difference(const HexSet& a, const HexSet& b) throw(hex::invalid_argument)
+{
+  HexSet result(a);
+  result -= b;
+  return result;
+}
+
+
+HexSet
+set_intersection(const HexSet& a, const HexSet& b)
+  throw(hex::invalid_argument)
+{
+  HexSet result(a);
+  result &= b;
+  return result;
+}
+
+
+HexSet
+set_union(const HexSet& a, const HexSet& b) throw(hex::invalid_argument)
+{
+  HexSet result(a);
+  result |= b;
+  return result;
+}
+
+
+std::vector<Area::Span>
+span_union(const std::vector<Area::Span>& a, const std::vector<Area::Span>& b)
+{
+  std::vector<Area::Span> merged;
+  merged.reserve(a.size() + b.size());
+  std::merge(a.begin(),a.end(),b.begin(),b.end(),std::back_inserter(merged));
+  // Join spans that overlap or touch.
+  std::vector<Area::Span> result;
+  for(std::vector<Area::Span>::const_iterator s=merged.begin(); s!=merged.end(); ++s)
+  {
+    if(!result.empty() && result.back().j==s->j && s->i0<=result.back().i1+1)
+        result.back().i1 = std::max(result.back().i1,s->i1);
+    else
+        result.push_back(*s);
+  }
+  return result;
+}
+
+
+std::vector<Area::Span>
+span_intersection(
+  const std::vector<Area::Span>& a,
+  const std::vector<Area::Span>& b
+)
+{
+  std::vector<Area::Span> result;
+  size_t ia =0;
+  size_t ib =0;
+  while(ia<a.size() && ib<b.size())
+  {
+    const Area::Span& x =a[ia];
+    const Area::Span& y =b[ib];
+    if(x.j!=y.j)
+    {
+      if(x.j<y.j) ++ia; else ++ib;
+      continue;
+    }
+    const int i0 =std::max(x.i0,y.i0);
+    const int i1 =std::min(x.i1,y.i1);
+    if(i0<=i1)
+        result.push_back( Area::Span(x.j,i0,i1) );
+    if(x.i1<y.i1) ++ia; else ++ib;
+  }
+  return result;
+}
+
+
+std::vector<Area::Span>
+span_difference(
+  const std::vector<Area::Span>& a,
+  const std::vector<Area::Span>& b
+)
+{
+  std::vector<Area::Span> result;
+  size_t ib =0;
+  for(std::vector<Area::Span>::const_iterator s=a.begin(); s!=a.end(); ++s)
+  {
+    while(ib<b.size() && (b[ib].j<s->j || (b[ib].j==s->j && b[ib].i1<s->i0)))
+        ++ib;
+    // Cut out every span in b that overlaps s.
+    int i0 =s->i0;
+    for(size_t k=ib; k<b.size() && b[k].j==s->j && b[k].i0<=s->i1; ++k)
+    {
+      if(i0<b[k].i0)
+          result.push_back( Area::Span(s->j,i0,b[k].i0-1) );
+      i0 = std::max(i0,b[k].i1+1);
+    }
+    if(i0<=s->i1)
+        result.push_back( Area::Span(s->j,i0,s->i1) );
+  }
+  return result;
+}
+
+
+std::string
+set_str(const HexSet& a)
+{
+  std::ostringstream ss;
+  for(HexSet::const_iterator h=a.begin(); h!=a.end(); ++h)
+      ss<<(**h).str()<<" ";
+  return ss.str();
+}
+
+
 std::string
 set_str(const std::set<Hex*>& a)
 {
@@ -215,6 +337,188 @@ bounding_box(const std::set<Hex*>& a, int& i0, int& j0, int& i1, int& j1)
 }
 
 
+bool
+bounding_box(const HexSet& a, int& i0, int& j0, int& i1, int& j1)
+{
+  for(HexSet::const_iterator h=a.begin(); h!=a.end(); ++h)
+  {
+    if(h==a.begin())
+    {
+      i0 = i1 = (**h).i;
+      j0 = j1 = (**h).j;
+    }
+    else
+    {
+      i0 = std::min(i0,(**h).i);
+      j0 = std::min(j0,(**h).j);
+      i1 = std::max(i1,(**h).i);
+      j1 = std::max(j1,(**h).j);
+    }
+  }
+  return !a.empty();
+}
+
+
+/** Helper: what flood() knows about each hex in a box of the grid, in one
+ *  flat array. The box starts round the seeds, and at least doubles in
+ *  width or height whenever the flood spreads out of it, so the flood takes
+ *  time in proportion to the area of its bounding box. Each hex is looked up
+ *  in beyond at most once. */
+class FloodMap
+{
+  enum State { UNKNOWN, FREE, BLOCKED, VISITED };
+  const Grid&                 _grid;
+  const HexSet&               _beyond;
+  int                         _i0,_j0,_i1,_j1; ///< The box, inclusive.
+  std::vector<unsigned char>  _state; ///< A State for each hex in the box.
+
+  size_t width(void) const { return size_t(_i1 - _i0 + 1); }
+  /** The State of hex i,j, which must be in the box. */
+  unsigned char& at(int i, int j)
+    {
+      unsigned char& result =_state[ size_t(i-_i0) + size_t(j-_j0) * width() ];
+      if(result==UNKNOWN)
+          result =( _beyond.grid()==&_grid && _beyond.count(i,j)
+                    ? BLOCKED: FREE );
+      return result;
+    }
+  /** Enlarges the box to hold hex i,j, which must be on the grid. */
+  void grow(int i, int j)
+    {
+      const int w =_i1 - _i0 + 1;
+      const int h =_j1 - _j0 + 1;
+      const int i0 =( i<_i0? std::max(0, std::min(i, _i0-w)): _i0 );
+      const int j0 =( j<_j0? std::max(0, std::min(j, _j0-h)): _j0 );
+      const int i1 =( i>_i1? std::min(_grid.cols()-1, std::max(i, _i1+w)): _i1 );
+      const int j1 =( j>_j1? std::min(_grid.rows()-1, std::max(j, _j1+h)): _j1 );
+      std::vector<unsigned char> state(
+          size_t(i1-i0+1) * size_t(j1-j0+1), (unsigned char)(UNKNOWN)
+        );
+      for(int y=_j0; y<=_j1; ++y)
+          std::copy( _state.begin() + size_t(y-_j0) * w,
+                     _state.begin() + size_t(y-_j0+1) * w,
+                     state.begin() + size_t(_i0-i0) + size_t(y-j0) * (i1-i0+1) );
+      _state.swap(state);
+      _i0 = i0; _j0 = j0; _i1 = i1; _j1 = j1;
+    }
+  bool in_box(int i, int j) const
+    { return _i0<=i && i<=_i1 && _j0<=j && j<=_j1; }
+
+public:
+  /** A map of the box i0,j0 - i1,j1 (clipped to the grid). */
+  FloodMap(const Grid& grid, const HexSet& beyond, int i0, int j0, int i1, int j1)
+    : _grid(grid), _beyond(beyond),
+      _i0(std::max(0,i0)), _j0(std::max(0,j0)),
+      _i1(std::min(grid.cols()-1,i1)), _j1(std::min(grid.rows()-1,j1)),
+      _state( width() * size_t(_j1 - _j0 + 1), (unsigned char)(UNKNOWN) )
+    {}
+
+  /** TRUE iff hex i,j (which must be on the grid) is in beyond. */
+  bool blocked(int i, int j)
+    {
+      if(!in_box(i,j))
+          grow(i,j);
+      return at(i,j)==BLOCKED;
+    }
+  /** TRUE iff the flood may spread into hex i,j. */
+  bool fillable(int i, int j)
+    {
+      if(!_grid.is_in_range(i,j))
+          return false;
+      if(!in_box(i,j))
+          grow(i,j);
+      return at(i,j)==FREE;
+    }
+  /** Marks hex i,j as filled. Returns FALSE if it already was. */
+  bool visit(int i, int j)
+    {
+      if(!in_box(i,j))
+          grow(i,j);
+      unsigned char& state =at(i,j);
+      if(state==VISITED)
+          return false;
+      state = VISITED;
+      return true;
+    }
+};
+
+
+/** Helper: Flood fill out from the hexes in a, without entering beyond.
+ *  A scanline fill: each seed is extended East & West into a span, and then
+ *  the rows above and below the span are scanned for new seeds. Hexes are
+ *  handled by co-ordinates, so the Hex objects are never touched. The result
+ *  is in SPANS storage. */
+inline Area
+flood(const HexSet& beyond, const Area& a)
+{
+  const std::set<Hex*>& hexes =a.hexes();
+  if(hexes.empty())
+      return a;
+  const Grid& grid =(**hexes.begin()).grid();
+  int i0,j0,i1,j1;
+  a.bounding_box(i0,j0,i1,j1);
+  FloodMap map(grid,beyond,i0-1,j0-1,i1+1,j1+1);
+  std::vector<Area::Span> spans;
+  std::vector<std::pair<int,int> > seeds;
+  for(std::set<Hex*>::const_iterator h=hexes.begin(); h!=hexes.end(); ++h)
+  {
+    const int i =(**h).i;
+    const int j =(**h).j;
+    if(!map.blocked(i,j))
+    {
+      seeds.push_back( std::make_pair(i,j) );
+    }
+    else if(map.visit(i,j))
+    {
+      // a's hexes are always in the result, but we can't spread from one
+      // that is in beyond as a span. Just try each of its neighbours.
+      spans.push_back( Area::Span(j,i,i) );
+      for(int d=0; d<DIRECTIONS; ++d)
+      {
+        int id =i;
+        int jd =j;
+        go(id,jd,A+d); // in/out: id,jd
+        seeds.push_back( std::make_pair(id,jd) );
+      }
+    }
+  }
+  while(!seeds.empty())
+  {
+    const int i =seeds.back().first;
+    const int j =seeds.back().second;
+    seeds.pop_back();
+    if(!map.fillable(i,j))
+        continue;
+    int i0 =i;
+    while(map.fillable(i0-1,j))
+        --i0;
+    int i1 =i;
+    while(map.fillable(i1+1,j))
+        ++i1;
+    for(int x=i0; x<=i1; ++x)
+        map.visit(x,j);
+    spans.push_back( Area::Span(j,i0,i1) );
+    int lo,hi;
+    touching(spans.back(),lo,hi); // out: lo,hi
+    lo = std::max(0,lo);
+    hi = std::min(grid.cols()-1,hi);
+    for(int jd=j-1; jd<=j+1; jd+=2)
+    {
+      if(jd<0 || jd>=grid.rows())
+          continue;
+      for(int x=lo; x<=hi; ++x)
+          if(map.fillable(x,jd))
+          {
+            seeds.push_back( std::make_pair(x,jd) );
+            while(x<=hi && map.fillable(x,jd)) // skip the run
+                ++x;
+          }
+    }
+  }
+  return Area(grid,spans,Area::TRUSTED);
+}
+
+
 Area
 fill(const std::set<Hex*>& beyond, Hex* h)
 {
@@ -225,69 +529,455 @@ fill(const std::set<Hex*>& beyond, Hex* h)
 Area
 fill(const std::set<Hex*>& beyond, const Area& a)
 {
-  std::set<Hex*> queue   =a.hexes();
-  std::set<Hex*> result  =a.hexes();
-  while(!queue.empty())
+  // Copy beyond into a HexSet, so that the flood can test membership by
+  // co-ordinates. Hexes from other grids can never be reached anyway.
+  const std::set<Hex*>& hexes =a.hexes();
+  if(hexes.empty())
+      return a;
+  const Grid& grid =(**hexes.begin()).grid();
+  HexSet b(grid);
+  for(std::set<Hex*>::const_iterator h=beyond.begin(); h!=beyond.end(); ++h)
+      if(&(**h).grid()==&grid)
+          b.insert(*h);
+  return flood(b,a);
+}
+
+
+Area
+fill(const HexSet& beyond, Hex* h)
+{
+  return fill( beyond, Area(h) );
+}
+
+
+Area
+fill(const HexSet& beyond, const Area& a)
+{
+  return flood(beyond,a);
+}
+
+
+/** Helper: The hexes in s, as sorted runs of hexes. */
+inline std::vector<Area::Span>
+to_spans(const std::set<Hex*>& s)
+{
+  std::vector<Area::Span> result;
+  result.reserve(s.size());
+  for(std::set<Hex*>::const_iterator h=s.begin(); h!=s.end(); ++h)
+      result.push_back( Area::Span((**h).j,(**h).i,(**h).i) );
+  std::sort(result.begin(),result.end());
+  return span_union(result,std::vector<Area::Span>());
+}
+
+
+/** Helper: Calls join(c,q) for every span c in [c0,c1) (one row) and span q
+ *  in [p0,c0) (the row below) that touch. A single merge pass. */
+template<class Join>
+inline void
+join_rows(
+  const std::vector<Area::Span>& spans,
+  size_t p0, size_t c0, size_t c1,
+  Join& join
+)
+{
+  size_t p =p0;
+  for(size_t c=c0; c<c1; ++c)
+  {
+    int lo,hi;
+    touching(spans[c],lo,hi); // out: lo,hi
+    while(p<c0 && spans[p].i1<lo)
+        ++p;
+    for(size_t q=p; q<c0 && spans[q].i0<=hi; ++q)
+        join(c,q);
+  }
+}
+
+
+/** Helper: Union for join_rows(). Roots are always the lowest span in their
+ *  tree. Counts the number of successful unions. */
+struct SerialJoin
+{
+  std::vector<size_t>& parent;
+  size_t               unions;
+  SerialJoin(std::vector<size_t>& p): parent(p), unions(0) {}
+  void operator()(size_t c, size_t q)
   {
-    Hex* h = *queue.begin();
-    queue.erase( queue.begin() );
-    for(int d=0; d<DIRECTIONS; ++d)
+    const size_t rc =find_root(parent,c);
+    const size_t rq =find_root(parent,q);
+    if(rc!=rq)
     {
-      Hex* hd =h->go(A+d);
-      if(!beyond.count(hd) && !result.count(hd))
-      {
-        queue.insert(hd);
-        result.insert(hd);
-      }
+      parent[std::max(rc,rq)] = std::min(rc,rq);
+      ++unions;
     }
   }
-  return result;
+};
+
+
+/** Helper: Union-find labelling of spans [begin,end). Each row is joined to
+ *  the row below it, so the whole sweep is linear. Sets up parent for the
+ *  range, and returns the number of components in it.
+ *  If stop_early, then gives up as soon as a component is complete while
+ *  other spans remain, and returns 2. */
+inline size_t
+join_spans(
+  const std::vector<Area::Span>& spans,
+  size_t                         begin,
+  size_t                         end,
+  std::vector<size_t>&           parent,
+  bool                           stop_early
+)
+{
+  std::vector<size_t> stamp; // stamp[root]: last row with a span in root.
+  if(stop_early)
+      stamp.resize(spans.size(),size_t(-1));
+  SerialJoin join(parent);
+  size_t count =0;
+  size_t p0 =begin; // Previous row is spans [p0,c0).
+  size_t c0 =begin; // Current row is spans [c0,c1).
+  while(c0<end)
+  {
+    const int j =spans[c0].j;
+    size_t c1 =c0;
+    for(; c1<end && spans[c1].j==j; ++c1)
+        parent[c1] = c1;
+    count += c1 - c0;
+    const bool adjacent =( c0>begin && spans[c0-1].j==j-1 );
+    if(adjacent)
+        join_rows(spans,p0,c0,c1,join);
+    if(stop_early && c0>begin)
+    {
+      // A component in the previous row that doesn't reach this row is
+      // complete. Since this row exists, it can't be the only component.
+      for(size_t c=c0; c<c1; ++c)
+          stamp[find_root(parent,c)] = c0;
+      if(!adjacent)
+          return 2;
+      for(size_t q=p0; q<c0; ++q)
+          if(stamp[find_root(parent,q)]!=c0)
+              return 2;
+    }
+    p0 = c0;
+    c0 = c1;
+  }
+  return count - join.unions;
 }
 
 
-/** Helper: Find the connected set (Area) that contains the first hex in s. */
-inline std::set<Hex*>
-extract_connected_set(std::set<Hex*>& s)
+/** Helper: Lock-free union for join_rows(), for use across band seams while
+ *  other threads work on other seams. Only roots are ever re-parented, and
+ *  always to a lower span, so the forest can never form a cycle. */
+struct ConcurrentJoin
 {
-  std::set<Hex*> result;
-  std::set<Hex*> queue; // Hexes in result that have not yet been checked.
-  Hex* h =*s.begin(); // Just pick a random hex in s.
-  while(true)
+  size_t* parent;
+  ConcurrentJoin(size_t* p): parent(p) {}
+  size_t root(size_t n)
   {
-    result.insert(h);
-    s.erase(h);
-    if(s.empty())
-        break; // optimisation - not strictly necessary.
-    std::set<Hex*> range1 =set_intersection( s, range(h,1) );
-    queue.insert( range1.begin(), range1.end() );
-    if(queue.empty())
-        break;
-    h = *queue.begin();
-    queue.erase( queue.begin() );
+    while(true)
+    {
+      const size_t p =atomic_load(parent+n);
+      if(p==n)
+          return n;
+      const size_t g =atomic_load(parent+p);
+      if(g!=p)
+          compare_and_swap(parent+n,p,g); // Path halving. May fail; no matter.
+      n = g;
+    }
   }
-  return result;
+  void operator()(size_t c, size_t q)
+  {
+    while(true)
+    {
+      const size_t rc =root(c);
+      const size_t rq =root(q);
+      if(rc==rq || compare_and_swap(parent+std::max(rc,rq),std::max(rc,rq),
+                                    std::min(rc,rq)))
+          return;
+      // Another thread re-parented one of the roots. Try again.
+    }
+  }
+};
+
+
+/** Helper: One band of rows, for label(). */
+struct Band
+{
+  const std::vector<Area::Span>* spans;
+  std::vector<size_t>*           parent;
+  size_t                         begin,end;
+  bool                           seam; ///< FALSE: label band. TRUE: join seam.
+};
+
+
+/** Helper: Thread function for label(). Either labels the band, or joins its
+ *  first row to the last row of the band below. */
+inline void*
+label_band(void* arg)
+{
+  const Band& band =*static_cast<Band*>(arg);
+  const std::vector<Area::Span>& spans =*band.spans;
+  if(!band.seam)
+  {
+    join_spans(spans,band.begin,band.end,*band.parent,false);
+  }
+  else if(band.begin>0 && spans[band.begin-1].j==spans[band.begin].j-1)
+  {
+    size_t p0 =band.begin-1;
+    while(p0>0 && spans[p0-1].j==spans[band.begin].j-1)
+        --p0;
+    size_t c1 =band.begin;
+    while(c1<spans.size() && spans[c1].j==spans[band.begin].j)
+        ++c1;
+    ConcurrentJoin join(&(*band.parent)[0]);
+    join_rows(spans,p0,band.begin,c1,join);
+  }
+  return NULL;
 }
 
 
-std::list<Area>
-areas(const std::set<Hex*>& s)
+/** Helper: Runs label_band() for each band, one thread each. If a thread
+ *  cannot be started, then its band is done on this thread. */
+inline void
+run_bands(std::vector<Band>& bands)
 {
-  std::set<Hex*> unallocated = s;
-  std::list<Area> result;
-  while(!unallocated.empty())
+  std::vector<pthread_t> thread(bands.size());
+  std::vector<bool>      started(bands.size(),false);
+  for(size_t k=1; k<bands.size(); ++k)
+      started[k] =( 0==pthread_create(&thread[k],NULL,label_band,&bands[k]) );
+  label_band(&bands[0]);
+  for(size_t k=1; k<bands.size(); ++k)
+    if(started[k])
+        pthread_join(thread[k],NULL);
+    else
+        label_band(&bands[k]);
+}
+
+
+size_t
+label(
+  const std::vector<Area::Span>& spans,
+  std::vector<size_t>&           labels,
+  unsigned                       threads
+)
+{
+  std::vector<size_t> parent(spans.size());
+  // Split the spans into bands of whole rows, about the same size.
+  std::vector<Band> bands;
+  for(unsigned k=0; k<std::max(threads,1u); ++k)
+  {
+    size_t n =spans.size() * k / std::max(threads,1u);
+    while(n>0 && n<spans.size() && spans[n-1].j==spans[n].j)
+        ++n;
+    if(k>0 && (n<=bands.back().begin || n>=spans.size()))
+        continue;
+    if(k>0)
+        bands.back().end = n;
+    Band band ={ &spans, &parent, n, spans.size(), false };
+    bands.push_back(band);
+  }
+  if(bands.size()==1)
+  {
+    join_spans(spans,0,spans.size(),parent,false);
+  }
+  else
+  {
+    run_bands(bands);
+    for(size_t k=0; k<bands.size(); ++k)
+        bands[k].seam = true;
+    run_bands(bands);
+  }
+  // Roots are always the lowest span in their tree, so numbering them in
+  // order of appearance numbers the components by their first span.
+  labels.resize(spans.size());
+  size_t count =0;
+  for(size_t n=0; n<spans.size(); ++n)
   {
-    result.push_back( extract_connected_set(unallocated) );
+    const size_t r =find_root(parent,n);
+    labels[n] =( r==n? count++: labels[r] );
   }
+  return count;
+}
+
+
+/** Helper: Split spans into Areas, one per component. */
+inline std::list<Area>
+split(const Grid& grid, const std::vector<Area::Span>& spans, unsigned threads)
+{
+  std::vector<size_t> labels;
+  const size_t count =label(spans,labels,threads);
+  std::vector< std::vector<Area::Span> > parts(count);
+  for(size_t n=0; n<spans.size(); ++n)
+      parts[labels[n]].push_back(spans[n]);
+  std::list<Area> result;
+  for(size_t k=0; k<count; ++k)
+      result.push_back( Area(grid,parts[k],Area::TRUSTED) );
   return result;
 }
 
 
+std::list<Area>
+areas(const std::set<Hex*>& s, unsigned threads)
+{
+  if(s.empty())
+      return std::list<Area>();
+  return split( (**s.begin()).grid(), to_spans(s), threads );
+}
+
+
+std::list<Area>
+areas(const HexSet& s, unsigned threads)
+{
+  if(s.empty())
+      return std::list<Area>();
+  return split( *s.grid(), s.spans(), threads );
+}
+
+
+bool
+is_connected(const std::vector<Area::Span>& spans)
+{
+  std::vector<size_t> parent(spans.size());
+  return( join_spans(spans,0,spans.size(),parent,true)<=1 );
+}
+
+
 bool
 is_connected(const std::set<Hex*>& s)
 {
-  std::set<Hex*> unallocated = s;
-  extract_connected_set( unallocated );
-  return unallocated.empty();
+  return is_connected( to_spans(s) );
+}
+
+
+bool
+is_connected(const HexSet& s)
+{
+  return is_connected( s.spans() );
+}
+
+
+/** Helper: Hex co-ordinates i,j. */
+typedef std::vector< std::pair<int,int> > Coords;
+
+
+/** Helper: The hexes just beyond s: on the grid, not in s, but next to it. */
+inline Coords
+fringe(const HexSet& s)
+{
+  Coords result;
+  HexSet seen(*s.grid());
+  const std::vector<Area::Span> spans =s.spans();
+  for(std::vector<Area::Span>::const_iterator x=spans.begin(); x!=spans.end(); ++x)
+    for(int i=x->i0; i<=x->i1; ++i)
+      for(int d=0; d<DIRECTIONS; ++d)
+      {
+        int id =i;
+        int jd =x->j;
+        go(id,jd,A+d); // in/out: id,jd
+        if(s.grid()->is_in_range(id,jd) && !s.count(id,jd) && seen.insert(id,jd))
+            result.push_back( std::make_pair(id,jd) );
+      }
+  return result;
+}
+
+
+/** Helper: Multi-source breadth-first search. Spreads out from frontier for
+ *  up to max steps, but only into hexes where s.count(i,j)==into. Every hex
+ *  that is reached is added to seen (which should already hold frontier).
+ *  If layers is not NULL, then the hexes reached by each step are also
+ *  appended to it, as a new HexSet. Each hex is visited at most once. */
+inline void
+spread(
+  const HexSet&         s,
+  bool                  into,
+  Coords                frontier,
+  HexSet&               seen,
+  size_t                max,
+  std::vector<HexSet>*  layers
+)
+{
+  const Grid& grid =*seen.grid();
+  Coords next;
+  for(size_t step=0; step<max && !frontier.empty(); ++step)
+  {
+    if(layers)
+        layers->push_back( HexSet(grid) );
+    for(Coords::const_iterator h=frontier.begin(); h!=frontier.end(); ++h)
+      for(int d=0; d<DIRECTIONS; ++d)
+      {
+        int i =h->first;
+        int j =h->second;
+        go(i,j,A+d); // in/out: i,j
+        if(grid.is_in_range(i,j) && bool(s.count(i,j))==into &&
+           seen.insert(i,j))
+        {
+          next.push_back( std::make_pair(i,j) );
+          if(layers)
+              layers->back().insert(i,j);
+        }
+      }
+    frontier.swap(next);
+    next.clear();
+  }
+  if(layers && !layers->empty() && layers->back().empty())
+      layers->pop_back();
+}
+
+
+HexSet
+dilate(const HexSet& s, size_t r)
+{
+  if(s.empty())
+      return s;
+  HexSet result(s);
+  const std::vector<Area::Span> spans =s.spans();
+  Coords frontier;
+  for(std::vector<Area::Span>::const_iterator x=spans.begin(); x!=spans.end(); ++x)
+    for(int i=x->i0; i<=x->i1; ++i)
+        frontier.push_back( std::make_pair(i,x->j) );
+  spread(s,false,frontier,result,r,NULL);
+  return result;
+}
+
+
+HexSet
+erode(const HexSet& s, size_t r)
+{
+  if(s.empty() || r==0)
+      return s;
+  const Coords frontier =fringe(s);
+  HexSet outside(*s.grid());
+  for(Coords::const_iterator h=frontier.begin(); h!=frontier.end(); ++h)
+      outside.insert(h->first,h->second);
+  spread(s,true,frontier,outside,r,NULL);
+  return set_difference(s,outside);
+}
+
+
+HexSet
+opening(const HexSet& s, size_t r)
+{
+  return dilate(erode(s,r),r);
+}
+
+
+HexSet
+closing(const HexSet& s, size_t r)
+{
+  return erode(dilate(s,r),r);
+}
+
+
+std::vector<HexSet>
+distance_layers(const HexSet& s)
+{
+  std::vector<HexSet> result;
+  if(s.empty())
+      return result;
+  const Coords frontier =fringe(s);
+  HexSet seen(*s.grid());
+  for(Coords::const_iterator h=frontier.begin(); h!=frontier.end(); ++h)
+      seen.insert(h->first,h->second);
+  spread(s,true,frontier,seen,size_t(-1),&result);
+  return result;
 }
 
 
@@ -22,37 +22,178 @@
  */
 
 #include "hex.h"
+#include "internal.h"
 
+#include <algorithm>
 #include <cassert>
 #include <sstream>
 
 namespace hex {
 
 
+/** Each item is calculated at most once, and then installed lock-free.
+ *  Items never change once they are installed, so copies of an Area can
+ *  share the same Cache. */
+struct Area::Cache
+{
+  struct Box { int i0,j0,i1,j1; };
+  struct Fill { Hex* origin; std::list<Path> paths; };
+
+  size_t             refs;     ///< The number of Areas that share this.
+  std::set<Hex*>*    hexes;    ///< SPANS storage only.
+  std::list<Edge*>*  boundary;
+  std::list<Area>*   voids;
+  Box*               bbox;
+  Fill*              fill;     ///< Fill paths from one origin.
+  Cache(void)
+    : refs(1), hexes(NULL), boundary(NULL), voids(NULL), bbox(NULL), fill(NULL)
+    {}
+  ~Cache(void)
+    {
+      delete hexes;
+      delete boundary;
+      delete voids;
+      delete bbox;
+      delete fill;
+    }
+};
+
+
+namespace {
+
+/** Helper: Lock-free. Installs v in *slot, unless another thread got there
+ *  first, in which case v is thrown away. Returns the winner. */
+template<typename T>
+inline const T&
+remember(T** slot, T* v)
+{
+  if(!install(slot,v))
+      delete v;
+  return *atomic_load(slot);
+}
+
+} // end anonymous namespace
+
+
+Area::Cache&
+Area::cache(void) const
+{
+  Cache* result =atomic_load(&_cache);
+  if(!result)
+  {
+    result = new Cache();
+    if(!install(&_cache,result))
+    {
+      delete result;
+      result = atomic_load(&_cache);
+    }
+  }
+  return *result;
+}
+
+
+Area::Cache*
+Area::share(void) const
+{
+  Cache* result =atomic_load(&_cache);
+  if(result)
+      atomic_increment(&result->refs);
+  return result;
+}
+
+
+void
+Area::release(void)
+{
+  if(_cache && atomic_decrement(&_cache->refs)==0)
+      delete _cache;
+  _cache = NULL;
+}
+
+
 Boundary
 Area::boundary(void) const
 {
-  // Start with a random hex.
-  Hex* h =*_hexes.begin();
-  const Grid& grid =h->grid();
-  const int i0 =h->i;
-  const int j0 =h->j;
-  // Find an edge.
-  int i=0;
-  while(i<=i0 && !contains(grid.hex(i,j0)))
-      ++i;
-  std::list<Edge*> result;
-  result.push_back( grid.hex(i,j0)->edge(D) );
+  Cache& c =cache();
+  const std::list<Edge*>* cached =atomic_load(&c.boundary);
+  if(cached)
+      return *cached;
+  Hex* h;
+  if(_storage==SPANS)
+  {
+    // The start of any span is on the boundary.
+    h = _grid->hex(_spans.front().i0,_spans.front().j);
+  }
+  else
+  {
+    // Start with a random hex.
+    h = *_hexes.begin();
+    // Find an edge: the western-most hex in h's row. (Search the area, rather
+    // than the grid, so as not to touch hexes that are not in use.)
+    for(std::set<Hex*>::const_iterator x=_hexes.begin(); x!=_hexes.end(); ++x)
+        if((**x).j==h->j && (**x).i<h->i)
+            h = *x;
+  }
+  std::list<Edge*>* result =new std::list<Edge*>();
+  result->push_back( h->edge(D) );
   // Follow the edge round.
   while(true)
   {
-    Edge* e =result.back()->next_out();
+    Edge* e =result->back()->next_out();
     if( !e || !contains(e->hex()) )
-        e = result.back()->next_in();
-    if(e == result.front())
+        e = result->back()->next_in();
+    if(e == result->front())
         break;
-    result.push_back(e);
+    result->push_back(e);
+  }
+  return remember(&c.boundary,result);
+}
+
+
+/** Helper: The enclosed areas (holes) in the area with the given spans.
+ *  Every hex in a hole lies in a gap between two spans in its own row. So
+ *  the holes are the components of the gaps that never touch the edge of the
+ *  grid, nor a hex beyond the first & last hex of the row above or below. */
+inline std::list<Area>
+holes(const Grid& grid, const std::vector<Area::Span>& spans)
+{
+  std::vector<Area::Span> gaps;
+  if(spans.empty())
+      return std::list<Area>();
+  const int j0 =spans.front().j;
+  std::vector<Area::Span> hull(spans.back().j - j0 + 1, Area::Span(0,1,0));
+  for(size_t n=0; n<spans.size(); ++n)
+  {
+    const Area::Span& s =spans[n];
+    if(n>0 && spans[n-1].j==s.j)
+        gaps.push_back( Area::Span(s.j,spans[n-1].i1+1,s.i0-1) );
+    else
+        hull[s.j-j0] = s;
+    hull[s.j-j0].i1 = s.i1;
   }
+  std::vector<size_t> labels;
+  const size_t count =label(gaps,labels);
+  std::vector<bool> leaks(count,false);
+  for(size_t n=0; n<gaps.size(); ++n)
+  {
+    const Area::Span& g =gaps[n];
+    int lo,hi;
+    touching(g,lo,hi); // out: lo,hi
+    for(int jd=g.j-1; jd<=g.j+1; jd+=2)
+      if(jd<j0 || jd>=j0+int(hull.size()) || jd>=grid.rows() ||
+         lo<hull[jd-j0].i0 || hull[jd-j0].i1<hi)
+      {
+        leaks[labels[n]] = true;
+      }
+  }
+  std::vector< std::vector<Area::Span> > parts(count);
+  for(size_t n=0; n<gaps.size(); ++n)
+    if(!leaks[labels[n]])
+        parts[labels[n]].push_back(gaps[n]);
+  std::list<Area> result;
+  for(size_t k=0; k<count; ++k)
+    if(!leaks[k])
+        result.push_back( Area(grid,parts[k],Area::TRUSTED) );
   return result;
 }
 
@@ -60,16 +201,45 @@ Area::boundary(void) const
 std::list<Area>
 Area::enclosed_areas(void) const
 {
-  Area a =boundary().area();
-  return areas( set_difference( a._hexes, _hexes ) );
+  if(size()==0)
+      return std::list<Area>();
+  return voids();
+}
+
+
+const std::list<Area>&
+Area::voids(void) const
+{
+  Cache& c =cache();
+  const std::list<Area>* cached =atomic_load(&c.voids);
+  if(cached)
+      return *cached;
+  const Grid& grid =(_storage==SPANS? *_grid: (**_hexes.begin()).grid());
+  return remember( &c.voids, new std::list<Area>(holes(grid,spans())) );
+}
+
+
+std::list<Boundary>
+Area::contours(void) const
+{
+  std::list<Boundary> result;
+  if(size()==0)
+      return result;
+  result.push_back(boundary());
+  // Use the cached voids, so that each one remembers its boundary.
+  const std::list<Area>& voids =this->voids();
+  for(std::list<Area>::const_iterator v=voids.begin(); v!=voids.end(); ++v)
+      result.push_back(v->boundary());
+  return result;
 }
 
 
 std::list<Boundary>
 Area::skeleton(bool include_boundary) const
 {
+  const std::set<Hex*>& hexes =this->hexes();
   std::list<Boundary> result;
-  for(std::set<Hex*>::const_iterator h=_hexes.begin(); h!=_hexes.end(); ++h)
+  for(std::set<Hex*>::const_iterator h=hexes.begin(); h!=hexes.end(); ++h)
   {
     std::list<Edge*> edges;
     edges.push_back( (**h).edge(A) );
@@ -86,12 +256,18 @@ Area::skeleton(bool include_boundary) const
 std::list<hex::Path>
 Area::fillpaths(Hex* origin) const
 {
+  if(!origin)
+      origin = *hexes().begin();
+  Cache& c =cache();
+  const Cache::Fill* cached =atomic_load(&c.fill);
+  if(cached && cached->origin==origin)
+      return cached->paths;
   // Try to calculate a path that fills area.
-  std::set<Hex*> queue =_hexes;
+  std::set<Hex*> queue =hexes();
   std::set<Hex*> seen;
   std::list<Path> result;
   std::list<Hex*> path;
-  Hex*      hex = origin? origin: *queue.begin();
+  Hex*      hex = origin;
   Direction dir =F;
   while(!queue.empty())
   {
@@ -118,15 +294,67 @@ Area::fillpaths(Hex* origin) const
       ++d;
     }
   }
+  // Only the paths from the first origin asked for are remembered.
+  if(!cached)
+  {
+    Cache::Fill* fill =new Cache::Fill();
+    fill->origin = origin;
+    fill->paths.swap(result);
+    return remember(&c.fill,fill).paths;
+  }
   return result;
 }
 
 
+/** Helper: The row-span encoding of sorted spans. (See Area::str().) */
+inline std::string
+spans_str(const std::vector<Area::Span>& spans)
+{
+  std::ostringstream result;
+  int j      =spans.front().j;
+  int row_i0 =spans.front().i0; // First hex in the previous row.
+  int next_i =row_i0;           // Just after the previous span in this row.
+  bool first =true;
+  result << row_i0 << "_" << j << "=";
+  for(std::vector<Area::Span>::const_iterator s=spans.begin(); s!=spans.end(); ++s)
+  {
+    for(; j<s->j; ++j, first=true)
+        result << ";";
+    if(first)
+    {
+      result << (s->i0 - row_i0);
+      row_i0 = s->i0;
+      first = false;
+    }
+    else
+    {
+      result << "," << (s->i0 - next_i);
+    }
+    result << "," << (s->i1 - s->i0 + 1);
+    next_i = s->i1 + 1;
+  }
+  return result.str();
+}
+
+
 std::string
 Area::str(Hex* origin) const
 {
+  std::string compact;
   if(!origin)
-      origin=*_hexes.begin();
+  {
+    // Both encodings start from the first hex of the first span, written
+    // "i_j" before the '='. Every hex after the first costs at least one
+    // character in the fill-path encoding, so there's no need to calculate
+    // it if compact is short.
+    const std::vector<Span> s =spans();
+    compact = spans_str(s);
+    const std::string::size_type eq =compact.find('=');
+    if(compact.size() <= eq + size())
+        return compact;
+    const Grid& grid =(_storage==SPANS? *_grid: (**_hexes.begin()).grid());
+    origin = grid.hex(s.front().i0,s.front().j);
+  }
   std::ostringstream result;
   std::list<Path> paths  =this->fillpaths(origin);
   result << origin->str();
@@ -136,6 +364,8 @@ Area::str(Hex* origin) const
         result << ">" << hex::steps(origin,p->hexes().front());
     result << ":" << p->steps();
   }
+  if(!compact.empty() && compact.size() < result.str().size())
+      return compact;
   return result.str();
 }
 
@@ -143,48 +373,273 @@ Area::str(Hex* origin) const
 Area
 Area::go(const Direction& d, int distance) const throw(hex::out_of_range)
 {
-  Area result;
-  for(std::set<Hex*>::const_iterator h=_hexes.begin(); h!=_hexes.end(); ++h)
-  {
-    Hex* hex =(**h).go(d,distance);
-    if(!hex)
-        throw hex::out_of_range("Area::go");
-    result._hexes.insert(hex);
-  }
-  return result;
+  // Any translation is a constant offset in axial co-ordinates.
+  int i =0;
+  int j =0;
+  hex::go(i,j,d,distance); // in/out: i,j
+  return translate(axial_q(i,j),j);
 }
 
 
 Area
 Area::go(const std::string& steps) const throw(hex::out_of_range)
 {
+  int i =0;
+  int j =0;
+  hex::go(i,j,steps); // in/out: i,j
+  return translate(axial_q(i,j),j);
+}
+
+
+Area
+Area::translate(int dq, int dr) const throw(hex::out_of_range)
+{
+  if(_storage==SPANS)
+  {
+    // Every hex in a row moves by the same amount.
+    std::vector<Span> spans;
+    spans.reserve(_spans.size());
+    for(std::vector<Span>::const_iterator s=_spans.begin(); s!=_spans.end(); ++s)
+    {
+      const int j =s->j + dr;
+      const int di =offset_i(axial_q(0,s->j) + dq, j);
+      if(!_grid->is_in_range(s->i0+di,j) || !_grid->is_in_range(s->i1+di,j))
+          throw hex::out_of_range("Area::go");
+      spans.push_back( Span(j, s->i0+di, s->i1+di) );
+    }
+    return Area(*_grid,spans,TRUSTED); // Still connected.
+  }
   Area result;
+  if(_hexes.empty())
+      return result;
+  const Grid& grid =(**_hexes.begin()).grid();
   for(std::set<Hex*>::const_iterator h=_hexes.begin(); h!=_hexes.end(); ++h)
   {
-    Hex* hex =(**h).go(steps);
-    if(!hex)
+    const int j =(**h).j + dr;
+    const int i =offset_i(axial_q((**h).i,(**h).j) + dq, j);
+    if(!grid.is_in_range(i,j))
         throw hex::out_of_range("Area::go");
-    result._hexes.insert(hex);
+    result._hexes.insert( grid.hex(i,j) );
   }
   return result;
 }
 
 
-Area::Area(const std::set<Hex*>& hexes): _hexes(hexes)
+bool
+Area::contains(Hex* h) const
+{
+  if(_storage!=SPANS)
+      return _hexes.count(h)>0;
+  if(!h || &h->grid()!=_grid)
+      return false;
+  // Find the last span that starts at, or before h.
+  std::vector<Span>::const_iterator s =
+    std::upper_bound(_spans.begin(),_spans.end(),Span(h->j,h->i,h->i));
+  if(s==_spans.begin())
+      return false;
+  --s;
+  return( s->j==h->j && h->i<=s->i1 );
+}
+
+
+const std::set<Hex*>&
+Area::hexes(void) const
+{
+  if(_storage!=SPANS)
+      return _hexes;
+  Cache& c =cache();
+  const std::set<Hex*>* cached =atomic_load(&c.hexes);
+  if(cached)
+      return *cached;
+  std::set<Hex*>* result =new std::set<Hex*>();
+  for(std::vector<Span>::const_iterator s=_spans.begin(); s!=_spans.end(); ++s)
+      for(int i=s->i0; i<=s->i1; ++i)
+          result->insert( result->end(), _grid->hex(i,s->j) );
+  return remember(&c.hexes,result);
+}
+
+
+bool
+Area::bounding_box(int& i0, int& j0, int& i1, int& j1) const
+{
+  if(size()==0)
+      return false;
+  Cache& c =cache();
+  const Cache::Box* box =atomic_load(&c.bbox);
+  if(!box)
+  {
+    Cache::Box* b =new Cache::Box();
+    if(_storage==SPANS)
+    {
+      b->i0 = _spans.front().i0;
+      b->i1 = _spans.front().i1;
+      for(std::vector<Span>::const_iterator s=_spans.begin(); s!=_spans.end(); ++s)
+      {
+        b->i0 = std::min(b->i0,s->i0);
+        b->i1 = std::max(b->i1,s->i1);
+      }
+      b->j0 = _spans.front().j;
+      b->j1 = _spans.back().j;
+    }
+    else
+    {
+      hex::bounding_box(_hexes,b->i0,b->j0,b->i1,b->j1);
+    }
+    box = &remember(&c.bbox,b);
+  }
+  i0 = box->i0;
+  j0 = box->j0;
+  i1 = box->i1;
+  j1 = box->j1;
+  return true;
+}
+
+
+std::vector<Area::Span>
+Area::spans(void) const
+{
+  if(_storage==SPANS)
+      return _spans;
+  std::vector<Span> result;
+  result.reserve(_hexes.size());
+  for(std::set<Hex*>::const_iterator h=_hexes.begin(); h!=_hexes.end(); ++h)
+      result.push_back( Span((**h).j,(**h).i,(**h).i) );
+  std::sort(result.begin(),result.end());
+  return span_union(result,std::vector<Span>());
+}
+
+
+Area::Area(const std::set<Hex*>& hexes)
+  : _storage(HEXES), _grid(NULL), _spans(), _size(0), _hexes(hexes),
+    _cache(NULL)
+{
+#ifdef HEX_PARANOID_CHECKS
+  assert(!paranoid_checks() || is_connected(hexes));
+#endif
+}
+
+
+Area::Area(const std::set<Hex*>& hexes, Trusted)
+  : _storage(HEXES), _grid(NULL), _spans(), _size(0), _hexes(hexes),
+    _cache(NULL)
+{}
+
+
+Area::Area(const HexSet& hexes)
+  : _storage(HEXES), _grid(NULL), _spans(), _size(0),
+    _hexes(hexes.begin(),hexes.end()), _cache(NULL)
+{
+#ifdef HEX_PARANOID_CHECKS
+  assert(!paranoid_checks() || is_connected(hexes));
+#endif
+}
+
+
+Area::Area(Hex* h, int distance)
+  : _storage(HEXES), _grid(NULL), _spans(), _size(0), _hexes(), _cache(NULL)
+{
+  const Disc disc(h,distance);
+  _hexes.insert(disc.begin(),disc.end());
+}
+
+
+Area::Area(const Grid& grid, const std::vector<Span>& spans)
+  throw(hex::out_of_range)
+  : _storage(SPANS), _grid(&grid), _spans(), _size(0), _hexes(),
+    _cache(NULL)
 {
+  set_spans(spans);
 #ifdef HEX_PARANOID_CHECKS
-  assert(is_connected(hexes));
+  assert(!paranoid_checks() || is_connected(_spans));
 #endif
 }
 
 
-Area::Area(Hex* h, int distance): _hexes()
+Area::Area(const Grid& grid, const std::vector<Span>& spans, Trusted)
+  throw(hex::out_of_range)
+  : _storage(SPANS), _grid(&grid), _spans(), _size(0), _hexes(),
+    _cache(NULL)
+{
+  set_spans(spans);
+}
+
+
+void
+Area::set_spans(const std::vector<Span>& spans) throw(hex::out_of_range)
 {
-  for(int i=0; i<=distance; ++i)
+  const Grid& grid =*_grid;
+  std::vector<Span> sorted;
+  sorted.reserve(spans.size());
+  for(std::vector<Span>::const_iterator s=spans.begin(); s!=spans.end(); ++s)
   {
-    std::set<Hex*> s =range(h,i);
-    std::copy(s.begin(),s.end(),inserter(_hexes,_hexes.end()));
+    if(s->i1<s->i0)
+        continue;
+    if(!grid.is_in_range(s->i0,s->j) || !grid.is_in_range(s->i1,s->j))
+        throw hex::out_of_range("Area: span is off the grid");
+    sorted.push_back(*s);
   }
+  std::sort(sorted.begin(),sorted.end());
+  _spans = span_union(sorted,std::vector<Span>());
+  for(std::vector<Span>::const_iterator s=_spans.begin(); s!=_spans.end(); ++s)
+      _size += s->i1 - s->i0 + 1;
+}
+
+
+Area::Area(const Area& a, Storage storage)
+  : svg::Identity(a), _storage(storage), _grid(NULL), _spans(), _size(0),
+    _hexes(), _cache(a.share()) // Same hexes, so the same derived geometry.
+{
+  if(storage==HEXES)
+  {
+    _hexes = a.hexes();
+  }
+  else if(a._storage==SPANS)
+  {
+    _grid  = a._grid;
+    _spans = a._spans;
+    _size  = a._size;
+  }
+  else if(!a._hexes.empty())
+  {
+    _grid = &(**a._hexes.begin()).grid();
+    set_spans( a.spans() );
+  }
+}
+
+
+Area::Area(const Area& right)
+  : svg::Identity(right),
+    _storage(right._storage),
+    _grid(right._grid),
+    _spans(right._spans),
+    _size(right._size),
+    _hexes(right._hexes),
+    _cache(right.share())
+{}
+
+
+Area&
+Area::operator=(const Area& right)
+{
+  if(this!=&right)
+  {
+    svg::Identity::operator=(right);
+    _storage = right._storage;
+    _grid    = right._grid;
+    _spans   = right._spans;
+    _size    = right._size;
+    _hexes   = right._hexes;
+    Cache* c =right.share();
+    release();
+    _cache = c;
+  }
+  return *this;
+}
+
+
+Area::~Area(void)
+{
+  release();
 }
 
 
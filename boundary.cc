@@ -181,12 +181,14 @@ Area
 Boundary::area(void) const
 {
   assert(is_closed());
-  std::set<Hex*> beyond;
+  HexSet beyond;
   std::set<Hex*> queue;
   for(std::list<Edge*>::const_iterator e=_edges.begin(); e!=_edges.end(); ++e)
   {
-    queue.insert(  (**e).hex() );
-    beyond.insert( (**e).hex()->go( (**e).direction() ) ); // NULL is OK.
+    queue.insert( (**e).hex() );
+    Hex* h =(**e).hex()->go( (**e).direction() );
+    if(h) // NULL is off the grid, so the fill can't go there anyway.
+        beyond.insert(h);
   }
   return fill(beyond,queue);
 }
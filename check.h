@@ -0,0 +1,70 @@
+// Minimal harness for the test_*.cc behaviour tests. `make check` builds and
+// runs each one; a test program exits non-zero if any CHECK fails.
+
+#ifndef LIBHEX_CHECK_H
+#define LIBHEX_CHECK_H
+
+#include "hex.h"
+
+#include <cstdlib>
+#include <iostream>
+
+namespace check {
+
+inline int& failures(void)
+{
+  static int result =0;
+  return result;
+}
+
+inline bool fail(const char* file, int line, const char* what)
+{
+  std::cerr<<file<<":"<<line<<": CHECK failed: "<<what<<std::endl;
+  ++failures();
+  return false;
+}
+
+/** Deterministic pseudo-random numbers in [0,n), so that failures repeat. */
+inline int random(int n)
+{
+  static unsigned long long state =88172645463325252ULL;
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return int(state % (unsigned long long)(n));
+}
+
+/** A random set of about percent% of the hexes of g. */
+inline hex::HexSet random_hexset(const hex::Grid& g, int percent)
+{
+  hex::HexSet result(g);
+  for(int j=0; j<g.rows(); ++j)
+    for(int i=0; i<g.cols(); ++i)
+      if(random(100)<percent)
+          result.insert(i,j);
+  return result;
+}
+
+/** Call at the end of main(). */
+inline int report(const char* name)
+{
+  if(failures())
+      std::cerr<<name<<": "<<failures()<<" check(s) failed"<<std::endl;
+  else
+      std::cout<<name<<": OK"<<std::endl;
+  return failures()? EXIT_FAILURE: EXIT_SUCCESS;
+}
+
+} // end namespace check
+
+#define CHECK(expr) \
+  ((expr)? true: check::fail(__FILE__,__LINE__,#expr))
+
+/** CHECK that stmt throws exception type E. */
+#define CHECK_THROWS(stmt,E) \
+  do{ bool thrown_ =false; \
+      try{ stmt; }catch(E&){ thrown_=true; } \
+      if(!thrown_) check::fail(__FILE__,__LINE__,#stmt " throws " #E); \
+  }while(0)
+
+#endif // LIBHEX_CHECK_H
@@ -44,9 +44,7 @@ char to_char(Direction d)
 Direction& operator+=(Direction& d, int i)
 {
   int d_ =static_cast<int>( d );
-  d_= (d_+i) % DIRECTIONS;
-  while(d_<0)
-    d_ += DIRECTIONS;
+  d_= (d_ + i % DIRECTIONS + DIRECTIONS) % DIRECTIONS;
   d=static_cast<Direction>( d_ );
   return d;
 }
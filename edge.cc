@@ -126,7 +126,7 @@ Edge::join_point(const Edge* next, float bias) const
   else // clockwise
   {
 #ifdef HEX_PARANOID_CHECKS
-    assert(next == next_out(true));
+    assert(!paranoid_checks() || next == next_out(true));
 #endif
     Point p =corner_offset( _hex->centre(), _direction - 1, 0.0 );
     return corner_offset( p, _direction + 1, bias );
@@ -23,11 +23,17 @@
 
 #include "hex.h"
 
+#include "internal.h"
+
+#include <algorithm>
 #include <sstream>
 #include <cmath>
 #include <cerrno>
 #include <cassert>
 #include <cstdlib>
+#include <cctype>
+#include <limits>
+#include <new>
 
 namespace hex {
 
@@ -68,22 +74,144 @@ Point::str(void) const
 // Grid
 
 
+/** SPARSE storage is divided into square tiles, TILE hexes on a side. Each
+ *  tile is a contiguous, row-major block of Hexes. The tiles are found
+ *  through a tree of square sectors, TILE slots on a side: the bottom level
+ *  holds tiles, each level above holds sectors. Tiles and sectors are only
+ *  made when they are first needed, so memory follows usage, even on grids
+ *  that are far too big to ever fill. */
+const int TILE_BITS =6;
+const int TILE =1<<TILE_BITS;
+
+
+/** Helper: number of tiles needed to cover n hexes. */
+inline size_t tiles(int n)
+{
+  return (size_t(n) + TILE - 1) / TILE;
+}
+
+
+/** Helper: number of levels of sectors needed to cover n hexes. */
+inline int depth(int n)
+{
+  int result =1;
+  for(size_t span =TILE; span < tiles(n); span *=TILE)
+      ++result;
+  return result;
+}
+
+
+/** Helper: the slot for tile (ti,tj) in a sector at the given level of the
+ *  tree. (Level 0 is the bottom level, which holds tiles.) */
+inline size_t slot(size_t ti, size_t tj, int level)
+{
+  const int shift =level * TILE_BITS;
+  return ((ti >> shift) & (TILE-1)) + ((tj >> shift) & (TILE-1)) * TILE;
+}
+
+
+/** Helper: the width of tile t, in a row of n hexes. (Tiles on the edge of
+ *  the grid are clipped, so that small grids stay small.) */
+inline int tile_width(size_t t, int n)
+{
+  return std::min( TILE, n - int(t)*TILE );
+}
+
+
+struct Grid::Sector
+{
+  union {
+    Sector* sectors[TILE*TILE]; ///< Upper levels. NULL until first used.
+    Hex*    tiles[TILE*TILE];   ///< Bottom level. NULL until first used.
+  };
+  Sector(void) { std::fill(tiles, tiles+TILE*TILE, static_cast<Hex*>(NULL)); }
+};
+
+
+/** Helper: Lock-free. Returns *slot, first filling it with a new T if it's
+ *  NULL. Threads may race to make the same T, but only one wins install();
+ *  the losers throw their copies away. */
+template<typename T>
+inline T* demand(T** slot, Allocator* allocator)
+{
+  T* result =atomic_load(slot);
+  if(!result)
+  {
+    result =new(allocator->allocate(sizeof(T))) T();
+    if(!install(slot,result))
+    {
+      allocator->deallocate(result,sizeof(T));
+      result =atomic_load(slot);
+    }
+  }
+  return result;
+}
+
+
+/** The default Allocator just uses operator new & delete. */
+class NewAllocator: public Allocator
+{
+public:
+  virtual void* allocate(size_t bytes) { return ::operator new(bytes); }
+  virtual void  deallocate(void* p, size_t) { ::operator delete(p); }
+};
+
+static NewAllocator new_allocator;
+
+
 Hex*
 Grid::hex(int i, int j) const throw(hex::out_of_range)
 {
-  int key =Hex::_key(i,j);
-  std::map<int,Hex*>::const_iterator pos =_hexes.find(key);
-  if(pos==_hexes.end())
+  if(0>i || i>=_cols)
+      throw hex::out_of_range("i");
+  if(0>j || j>=_rows)
+      throw hex::out_of_range("j");
+  if(_block)
+      return _block + i + size_t(j) * _cols;
+  // SPARSE: Lock-free. Threads may race to make the same tile, but only one
+  // wins install(); the losers throw their copies away.
+  const size_t ti =i/TILE;
+  const size_t tj =j/TILE;
+  Sector* sector =demand(&_root,_allocator);
+  for(int level=_depth-1; level>0; --level)
+      sector =demand(sector->sectors + slot(ti,tj,level), _allocator);
+  Hex** tslot =sector->tiles + slot(ti,tj,0);
+  Hex* tile =atomic_load(tslot);
+  if(!tile)
   {
-    if(0>i || i>=_cols)
-        throw hex::out_of_range("i");
-    if(0>j || j>=_rows)
-        throw hex::out_of_range("j");
-    Hex* newhex = new Hex(*this,i,j);
-    _hexes.insert( std::make_pair(key,newhex) );
-    return newhex;
+    tile =new_tile(ti,tj);
+    if(!install(tslot,tile))
+    {
+      _allocator->deallocate(tile,tile_bytes(ti,tj));
+      tile =atomic_load(tslot);
+    }
   }
-  return pos->second;
+  return tile + (i - ti*TILE) + (j - tj*TILE) * tile_width(ti,_cols);
+}
+
+
+size_t
+Grid::tile_bytes(size_t ti, size_t tj) const
+{
+  return sizeof(Hex) * tile_width(ti,_cols) * tile_width(tj,_rows);
+}
+
+
+Hex*
+Grid::new_tile(size_t ti, size_t tj) const
+{
+  const int i0 =ti*TILE;
+  const int j0 =tj*TILE;
+  const int i1 =i0 + tile_width(ti,_cols);
+  const int j1 =j0 + tile_width(tj,_rows);
+  // Hex has no default constructor, so allocate raw memory and then
+  // construct each Hex in place.
+  Hex* result =static_cast<Hex*>( _allocator->allocate(tile_bytes(ti,tj)) );
+  Hex* h =result;
+  for(int j=j0; j<j1; ++j)
+      for(int i=i0; i<i1; ++i)
+          new(h++) Hex(*this,i,j);
+  return result;
 }
 
 
@@ -144,7 +272,7 @@ Grid::to_area(void) const
   for(int i=0; i<_cols; ++i)
       for(int j=0; j<_rows; ++j)
           hexes.insert( hex(i,j) );
-  return Area(hexes);  
+  return Area(hexes,Area::TRUSTED);
 }
 
 
@@ -187,16 +315,81 @@ Grid::hexes(const std::string& s) const throw(out_of_range,invalid_argument)
 }
 
 
+/** Helper: Parse an integer that matches /^-?[0-9]+/ at buf. strtol() alone
+ *  would also skip white space and accept '+', which hex.js does not.
+ *  Sets endptr just after the number. */
+inline long
+span_number(const char* buf, char** endptr, const std::string& s)
+  throw(invalid_argument)
+{
+  if(!isdigit( static_cast<unsigned char>(buf[ *buf=='-'? 1: 0 ]) ))
+      throw hex::invalid_argument(s);
+  return ::strtol(buf,endptr,10);
+}
+
+
+/** Helper: Parse the row-span encoding of an area, that follows its first hex.
+ *  E.g. 1_2=0,3;-1,2,1,4  (See Area::str().) */
+inline Area
+span_area(const Grid& grid, int i, int j, const std::string& s)
+  throw(out_of_range,invalid_argument)
+{
+  std::vector<Area::Span> spans;
+  const char* buf =s.c_str();
+  char* endptr =NULL;
+  int row_i0 =i;     // First hex in the previous row.
+  int next_i =i;     // Just after the previous span in this row.
+  bool first =true;
+  errno=0;
+  while(*buf)
+  {
+    if(*buf==';')
+    {
+      ++j;
+      first = true;
+      ++buf;
+      continue;
+    }
+    if(!first && *buf++!=',')
+        throw hex::invalid_argument(s);
+    const long offset =span_number(buf,&endptr,s);
+    if(*endptr!=',')
+        throw hex::invalid_argument(s);
+    buf =endptr+1;
+    const long length =span_number(buf,&endptr,s);
+    if(length<1)
+        throw hex::invalid_argument(s);
+    buf =endptr;
+    if(ERANGE==errno || length>grid.cols() || offset>grid.cols() ||
+       offset < -grid.cols())
+    {
+      throw hex::out_of_range(s);
+    }
+    const int i0 =int(offset) + (first? row_i0: next_i);
+    if(first)
+        row_i0 = i0;
+    first = false;
+    next_i = i0 + int(length);
+    spans.push_back( Area::Span(j,i0,next_i-1) );
+  }
+  if(spans.empty())
+      throw hex::invalid_argument(s);
+  return Area(grid,spans);
+}
+
+
 Area
 Grid::area(const std::string& s) const throw(out_of_range,invalid_argument)
 {
   // Parse string of area fillpaths
   // E.g. 1,2>CDE:ABC
   std::set<Hex*> result;
-  std::string::size_type pos =s.find_first_of(":>");
+  std::string::size_type pos =s.find_first_of(":>=");
   if(pos==std::string::npos)
       throw hex::invalid_argument(s);
   Hex* origin =this->hex( s.substr(0,pos) );
+  if(s[pos]=='=')
+      return span_area(*this,origin->i,origin->j,s.substr(pos+1));
   Hex* start  =origin;
   while(pos!=std::string::npos)
   {
@@ -262,32 +455,88 @@ Grid::boundary(const std::string& s) const throw(out_of_range,invalid_argument)
 }
 
 
-Grid::Grid(int cols, int rows) throw(hex::out_of_range)
-  : _hexes(), _cols(cols), _rows(rows)
+void
+Grid::init(void)
 {
-  // Perhaps it's perverse to use ints, and then restrict them to be only
-  // short. I think it just makes the interface less quirky, the code a
-  // bit more efficient, and using shorts wouldn't really save much memory.
-  if(0>cols || cols>=0x4000)
+  if(!_allocator)
+      _allocator =&new_allocator;
+  if(_storage==DENSE)
+  {
+    // The DENSE block is simply one big tile.
+    if(_cols && _rows)
+    {
+      _block =static_cast<Hex*>(
+          _allocator->allocate( size_t(_cols) * _rows * sizeof(Hex) )
+        );
+      Hex* h =_block;
+      for(int j=0; j<_rows; ++j)
+          for(int i=0; i<_cols; ++i)
+              new(h++) Hex(*this,i,j);
+    }
+  }
+  else
+  {
+    // The root sector is made by the first call to hex().
+    _depth =depth( std::max(_cols,_rows) );
+  }
+}
+
+
+void
+Grid::release(Sector* sector, int level, size_t ti, size_t tj)
+{
+  // (ti,tj) is the first tile under sector.
+  const int shift =level * TILE_BITS;
+  for(size_t t=0; t<size_t(TILE*TILE); ++t)
+  {
+    const size_t ci =ti + ((t % TILE) << shift);
+    const size_t cj =tj + ((t / TILE) << shift);
+    if(level && sector->sectors[t])
+        release(sector->sectors[t], level-1, ci, cj);
+    else if(!level && sector->tiles[t])
+        _allocator->deallocate(sector->tiles[t],tile_bytes(ci,cj));
+  }
+  _allocator->deallocate(sector,sizeof(Sector));
+}
+
+
+Grid::Grid(int cols, int rows, Storage storage, Allocator* allocator)
+  throw(hex::out_of_range)
+  : _root(NULL), _depth(0), _block(NULL), _cols(cols), _rows(rows),
+    _storage(storage), _allocator(allocator)
+{
+  if(0>cols)
       throw hex::out_of_range("cols");
-  if(0>rows || rows>=0x4000)
+  if(0>rows)
       throw hex::out_of_range("rows");
+  // A DENSE grid must fit in memory that can be counted in bytes.
+  if(storage==DENSE && rows &&
+     size_t(cols) > std::numeric_limits<size_t>::max() / sizeof(Hex) / rows)
+  {
+    throw hex::out_of_range("cols * rows");
+  }
+  init();
 }
 
 
-Grid::Grid(const Grid& v): _hexes(), _cols(v._cols), _rows(v._rows)
+Grid::Grid(const Grid& v)
+  : _root(NULL), _depth(0), _block(NULL), _cols(v._cols), _rows(v._rows),
+    _storage(v._storage), _allocator(v._allocator)
 {
-  using namespace std;
-  for(map<int,Hex*>::const_iterator h =v._hexes.begin(); h!=v._hexes.end(); ++h)
-      _hexes.insert( make_pair(h->first,new Hex(*this,*h->second)) );
+  // A Hex has no state apart from its co-ordinates, so there's nothing to
+  // copy from v. A SPARSE copy just makes its own tiles, as they are used.
+  init();
 }
 
 
 Grid::~Grid()
 {
-  using namespace std;
-  for(map<int,Hex*>::const_iterator h =_hexes.begin(); h!=_hexes.end(); ++h)
-      delete h->second;
+  // Hex's destructor does nothing, so all of their memory can simply be
+  // released in bulk.
+  if(_root)
+      release(_root,_depth-1,0,0);
+  if(_block)
+      _allocator->deallocate(_block,size_t(_cols)*_rows*sizeof(Hex));
 }
 
 
@@ -23,6 +23,9 @@
 
 #include "hex.h"
 
+#include "internal.h"
+
+#include <algorithm>
 #include <sstream>
 
 namespace hex {
@@ -50,20 +53,36 @@ Hex::edge(const Direction& d) const
 }
 
 
+/** Helper: the hex at i,j, or NULL if that is off the grid. */
+inline Hex*
+hex_or_null(const Grid& grid, int i, int j)
+{
+  return( grid.is_in_range(i,j)? grid.hex(i,j): NULL );
+}
+
+
 Hex*
 Hex::go(const Direction& d, int distance) const
 {
+  if(distance==1)
+  {
+    Hex* const self =const_cast<Hex*>(this);
+    Hex* result =atomic_load(_adjacent+d);
+    if(!result)
+    {
+      int i_ =this->i;
+      int j_ =this->j;
+      hex::go(i_,j_,d); // in/out: i_,j_
+      result =hex_or_null(_grid,i_,j_);
+      // Racing threads all calculate the same value, so any of them may win.
+      atomic_store(_adjacent+d, result? result: self);
+    }
+    return( result==self? NULL: result );
+  }
   int i_ =this->i;
   int j_ =this->j;
   hex::go(i_,j_,d,distance); // in/out: i_,j_ 
-  try
-  {
-    return _grid.hex(i_,j_);
-  }
-  catch(hex::out_of_range)
-  {
-    return NULL;
-  }
+  return hex_or_null(_grid,i_,j_);
 }
 
 
@@ -73,14 +92,7 @@ Hex::go(const std::string& steps) const
   int i_ =this->i;
   int j_ =this->j;
   hex::go(i_,j_,steps); // in/out: i_,j_ 
-  try
-  {
-    return _grid.hex(i_,j_);
-  }
-  catch(hex::out_of_range)
-  {
-    return NULL;
-  }
+  return hex_or_null(_grid,i_,j_);
 }
 
 
@@ -110,14 +122,9 @@ Hex::Hex(const Grid& grid, int i_, int j_):
   _edgeA(this,A), _edgeB(this,B), _edgeC(this,C),
   _edgeD(this,D), _edgeE(this,E), _edgeF(this,F),
   _grid(grid), i(i_), j(j_)
-{}
-
-
-Hex::Hex(const Grid& grid, const Hex& h):
-  _edgeA(this,A), _edgeB(this,B), _edgeC(this,C),
-  _edgeD(this,D), _edgeE(this,E), _edgeF(this,F),
- _grid(grid), i(h.i), j(h.j)
-{}
+{
+  std::fill(_adjacent, _adjacent+DIRECTIONS, static_cast<Hex*>(NULL));
+}
 
 
 } // end namespace hex
@@ -58,15 +58,25 @@
 #define FIRETREE__HEX_H 1
 
 
+#include <cstddef>
+#include <iterator>
 #include <list>
 #include <set>
 #include <map>
 #include <stdexcept>
 #include <ostream>
+#include <tr1/unordered_map>
 #include <string>
+#include <vector>
 
 
-#define HEX_PARANOID_CHECKS
+/** Expensive consistency checks, such as the connectivity check in the Area
+ *  constructors, are compiled in unless NDEBUG or HEX_NO_PARANOID_CHECKS is
+ *  defined when the library is built. Even then, they can be switched off at
+ *  run time with hex::set_paranoid_checks(false). */
+#if !defined(NDEBUG) && !defined(HEX_NO_PARANOID_CHECKS)
+#  define HEX_PARANOID_CHECKS
+#endif
 
 /** Library for manipulating hexagonal grids.
  *  Supports arbitrary areas and paths. */
@@ -165,7 +175,11 @@ namespace svg {
 class Grid;
 class Edge;
 class Hex;
+class HexSet;
 class Area;
+class Region;
+class Spiral;
+class Disc;
 class Path;
 class Boundary;
 
@@ -195,16 +209,51 @@ struct Point
 };
 
 
+/** Source of memory for a Grid's Hexes. A Grid takes memory in a few large
+ *  blocks, and hands them all back when it is destroyed. Supply your own
+ *  implementation to control where that memory comes from. Must outlive
+ *  every Grid that uses it. */
+class Allocator
+{
+public:
+  virtual ~Allocator(void) {}
+  virtual void* allocate(size_t bytes) =0;
+  virtual void  deallocate(void* p, size_t bytes) =0;
+};
+
+
 /** A square field of hexagons that form the universe in which the other
- *  objects exist. */
+ *  objects exist.
+ *
+ *  Concurrent calls to the const member functions of a Grid are safe, so
+ *  any number of threads may share one Grid (and its Hexes). SPARSE grids
+ *  construct their Hexes lock-free on first use; DENSE grids never change
+ *  after construction. */
 class Grid
 {
-  mutable std::map<int,Hex*> _hexes;
+public:
+  /** How the Grid stores its Hexes. */
+  enum Storage {
+    SPARSE, ///< Hexes are allocated in 64x64 tiles, when first used.
+    DENSE   ///< All Hexes are allocated up-front, in one contiguous block.
+  };
+private:
+  struct Sector;
+  mutable Sector* _root; ///< SPARSE storage. A tree of tiles of Hexes.
+  int _depth; ///< Levels of Sectors in the SPARSE tree.
+  Hex* _block; ///< DENSE storage. Row-major: hex(i,j) is _block[i+j*cols]
   int _cols;
   int _rows;
+  Storage _storage;
+  Allocator* _allocator;
+  Hex* new_tile(size_t ti, size_t tj) const;
+  size_t tile_bytes(size_t ti, size_t tj) const;
+  void release(Sector* sector, int level, size_t ti, size_t tj);
+  void init(void);
 public:
   int       cols(void) const { return _cols; }
   int       rows(void) const { return _rows; }
+  Storage   storage(void) const { return _storage; }
   Distance  width(void) const { return I/2.0 + I*cols(); }
   Distance  height(void) const { return K*2 + J*(rows()-1); }
   bool is_in_range(int i, int j) const {return 0<=i&&i<cols()&&0<=j&&j<rows();}
@@ -213,9 +262,19 @@ public:
   Hex*      hex(const Point& p) const throw(hex::out_of_range);
   Area      to_area(void) const;
 public: // construction
-  Grid(int cols, int rows) throw(hex::out_of_range);
+  /** DENSE storage gives faster lookups and iteration, at the cost of
+   *  allocating every Hex in the Grid immediately. SPARSE storage only
+   *  allocates memory for the regions that are actually used, so SPARSE
+   *  grids may be very large indeed.
+   *  If allocator is NULL, then memory comes from operator new. */
+  Grid(int cols, int rows, Storage storage =SPARSE, Allocator* allocator =NULL)
+    throw(hex::out_of_range);
 public: // housekeeping
-  /** Make a deep copy of the Grid. New & old Hexes are not interchangeable. */
+  /** Make a copy of the Grid. New & old Hexes are not interchangeable.
+   *  The copy shares nothing with right, but a SPARSE copy only makes its
+   *  Hexes as they are used, so it is very cheap to make. A DENSE copy
+   *  makes all of its Hexes at once, in time proportional to the grid.
+   *  The copy uses the same Allocator as right. */
   Grid(const Grid& right);
   virtual ~Grid(void);
 private:
@@ -227,7 +286,7 @@ public: // factory methods
   /** Parse strings generated by set_str() */
   std::set<Hex*> hexes(const std::string& s) const
     throw(out_of_range,invalid_argument);
-  /** Parse strings generated by Area::str() */
+  /** Parse strings generated by Area::str(), in either of its encodings. */
   Area area(const std::string& s) const
     throw(out_of_range,invalid_argument);
   /** Parse strings generated by Path::str() */
@@ -269,6 +328,9 @@ class Hex
 {
   Edge  _edgeA,_edgeB,_edgeC,_edgeD,_edgeE,_edgeF;
   const Grid& _grid;
+  /** Cache of adjacent hexes, filled in by go(d). NULL means 'not yet
+   *  known', and a pointer to this hex means 'off the edge of the grid'. */
+  mutable Hex* _adjacent[DIRECTIONS];
 public:
   const int  i; ///< in units of I
   const int  j; ///< in units of J
@@ -279,15 +341,18 @@ public:
   Hex*         go(const std::string& steps) const;
   Point        centre(void) const;
   std::string  str(void) const;
-  /** Generates a unique key for co-ordinates i,j. (i,j < 2^14) */
-  static int   _key(int i, int j) { return (i<<14) | j; }
+  /** Generates a unique key for co-ordinates i,j. (i,j < 2^31)
+   *  The library itself never uses this. It is kept for the scripting
+   *  bindings, whose Hex.__hash__ (hex.i) and Grid._key (hex.js) make the
+   *  same kind of key. */
+  static long long _key(int i, int j)
+    { return (static_cast<long long>(i)<<32) | static_cast<unsigned>(j); }
 public: // construction
   Hex(const Grid& grid, int i_, int j_);
 private:
   friend class Grid;
   Hex(const Hex& right);               ///< No implementation.
   Hex& operator=(const Hex&);          ///< No implementation.
-  Hex(const Grid& grid, const Hex& h); ///< Only callable by Grid.
   ~Hex(void) {}                        ///< Only callable by Grid.
 };
 
@@ -295,27 +360,392 @@ private:
 /** A connected set of hexes. */
 class Area: public svg::Identity
 {
-  std::set<Hex*>  _hexes;
 public:
-  size_t                 size(void) const { return _hexes.size(); }
-  bool                   contains(Hex* h) const { return _hexes.count(h)>0; }
+  /** Tag for the unchecked constructors. The caller promises that the
+   *  hexes are already known to be connected. */
+  enum Trusted { TRUSTED };
+
+  /** How an Area stores its hexes. HEXES is a set of Hex pointers. SPANS
+   *  records each row as a sorted list of runs of hexes, so its memory
+   *  scales with the perimeter of the area, rather than its size.
+   *  In SPANS storage, hexes() builds the set of Hex pointers on first use,
+   *  and then remembers it (see boundary()). */
+  enum Storage { HEXES, SPANS };
+
+  /** Hexes i0 to i1 (inclusive) in row j. */
+  struct Span
+  {
+    int j, i0, i1;
+    Span(int j_, int i0_, int i1_): j(j_), i0(i0_), i1(i1_) {}
+    bool operator<(const Span& v) const
+      { return( j<v.j || (j==v.j && i0<v.i0) ); }
+    bool operator==(const Span& v) const
+      { return( j==v.j && i0==v.i0 && i1==v.i1 ); }
+  };
+
+private:
+  /** Derived geometry, calculated on first use. An Area never changes, so
+   *  copies share one reference-counted cache, which is only thrown away
+   *  with the last of them. */
+  struct Cache;
+
+  Storage                 _storage;
+  const Grid*             _grid;  ///< SPANS only.
+  std::vector<Span>       _spans; ///< SPANS only. Sorted, and never touching.
+  size_t                  _size;  ///< SPANS only.
+  std::set<Hex*>          _hexes; ///< HEXES only.
+  mutable Cache*          _cache; ///< NULL until first needed.
+  Cache&                  cache(void) const;
+  Cache*                  share(void) const; ///< Adds a reference.
+  void                    release(void); ///< Drops this Area's reference.
+  const std::list<Area>&  voids(void) const; ///< Cached enclosed_areas().
+public:
+  Storage                storage(void) const { return _storage; }
+  size_t                 size(void) const
+                           { return _storage==SPANS? _size: _hexes.size(); }
+  bool                   contains(Hex* h) const;
+  /** The external boundary. Like the other derived geometry (enclosed areas,
+   *  bounding box & fill paths), it is calculated once and then remembered.
+   *  Concurrent calls to the const member functions of an Area are safe:
+   *  threads may race to calculate the same thing, but only the first
+   *  result is kept. */
   Boundary               boundary(void) const;
-  const std::set<Hex*>&  hexes(void) const { return _hexes; }
+  const std::set<Hex*>&  hexes(void) const;
+  /** The rows of the area, as sorted runs of hexes. */
+  std::vector<Span>      spans(void) const;
+  /** Calculate a bounding box for the area. Returns FALSE if it is empty. */
+  bool                   bounding_box(int& i0, int& j0, int& i1, int& j1) const;
+  /** The holes in the area, in order of their first hex (by row, then by
+   *  column). Linear in the number of spans. */
   std::list<Area>        enclosed_areas(void) const;
+  /** The external boundary, followed by the boundary of each enclosed area,
+   *  in the same order as enclosed_areas(). */
+  std::list<Boundary>    contours(void) const;
   /** For drawing the structure. If include_boundary is TRUE, then the
    *  last item in the list is the external boundary of the area. */
   std::list<Boundary>    skeleton(bool include_boundary =true) const;
   /** A list of one or more paths that include every hex in the area once. */
   std::list<hex::Path>   fillpaths(Hex* origin =NULL) const;
+  /** The area as a string. There are two encodings:
+   *   - Fill paths: "i_j:STEPS>STEPS:STEPS...", where i_j is origin. Each
+   *     ':' starts a Path at the current hex. Each '>' moves the current hex
+   *     away from origin, and each ':' path moves it back again afterwards.
+   *   - Row spans: "i_j=A,N,G,N;A,N...", where i_j is the first hex. Rows
+   *     are separated by ';', starting from row j. Each run of N hexes starts
+   *     G hexes after the previous run in its row. The first run in each
+   *     row starts A hexes after the first run in the row before.
+   *  If origin is NULL, then the shorter of the two is used. Otherwise the
+   *  fill path encoding is used, starting from origin.
+   *  Both are parsed by Grid::area(). */
   std::string            str(Hex* origin =NULL) const;
 public: // transformations
   Area  go(const Direction& d, int distance=1) const throw(hex::out_of_range);
   Area  go(const std::string& steps) const throw(hex::out_of_range);
+private:
+  /** Translation by axial offset dq,dr. */
+  Area  translate(int dq, int dr) const throw(hex::out_of_range);
+  /** Sorts, merges & stores spans. Needs _grid. */
+  void  set_spans(const std::vector<Span>& spans) throw(hex::out_of_range);
 public: // construction
-  Area(void): _hexes() {} ///< Required for list<Area>
+  Area(void) ///< Required for list<Area>
+    : _storage(HEXES), _grid(NULL), _spans(), _size(0), _hexes(), _cache(NULL)
+    {}
   Area(const std::set<Hex*>& hexes);
-  Area(Hex* h): _hexes() { _hexes.insert(h); }
-  Area(Hex* h, int distance); ///< All hexes <= distance from h.
+  Area(const HexSet& hexes);
+  Area(Hex* h)
+    : _storage(HEXES), _grid(NULL), _spans(), _size(0), _hexes(), _cache(NULL)
+    { _hexes.insert(h); }
+  Area(Hex* h, int distance); ///< All hexes <= distance from h. (May be empty.)
+  /** An Area in SPANS storage. The spans may be in any order, and may overlap.
+   *  Empty spans (i1<i0) are ignored. */
+  Area(const Grid& grid, const std::vector<Span>& spans)
+    throw(hex::out_of_range);
+  /** Unchecked versions of the constructors above. Use them when the hexes
+   *  are known to be connected, to skip the paranoid check. */
+  Area(const std::set<Hex*>& hexes, Trusted);
+  Area(const Grid& grid, const std::vector<Span>& spans, Trusted)
+    throw(hex::out_of_range);
+  /** A copy of a, with the given storage. */
+  Area(const Area& a, Storage storage);
+public: // housekeeping
+  Area(const Area& right);
+  Area& operator=(const Area& right);
+  virtual ~Area(void);
+};
+
+
+/** A set of hexes from a single Grid, stored as a bitmap.
+ *  Hex i,j is bit i+j*cols. The bitmap is sparse: it is divided into blocks
+ *  of BLOCK_BITS, and only blocks with at least one member are stored. A map
+ *  finds each block from its number, so blocks can be made in any order.
+ *  Set algebra works on whole words at a time, so combining two large sets
+ *  costs a few operations per 64 hexes.
+ *  Iteration is in order of increasing j, then increasing i. */
+class HexSet
+{
+public:
+  typedef unsigned long long  Word;
+  enum { WORD_BITS=64, BLOCK_WORDS=64, BLOCK_BITS=WORD_BITS*BLOCK_WORDS };
+
+  /** Forward iterator over the members of a HexSet. */
+  class const_iterator
+  {
+    typedef std::map<unsigned long long,size_t>::const_iterator  Block;
+    const HexSet*  _set;
+    Block          _block; ///< Position in _set->_blocks.
+    size_t         _bit;   ///< Bit within the block.
+    void           seek(void); ///< Advance to the next member, or end().
+  public:
+    typedef std::forward_iterator_tag  iterator_category;
+    typedef Hex*                       value_type;
+    typedef ptrdiff_t                  difference_type;
+    typedef Hex* const*                pointer;
+    typedef Hex*                       reference;
+    Hex*             operator*(void) const;
+    const_iterator&  operator++(void) { ++_bit; seek(); return *this; }
+    const_iterator   operator++(int)
+                       { const_iterator r(*this); ++*this; return r; }
+    bool  operator==(const const_iterator& v) const
+            { return(_block==v._block && _bit==v._bit); }
+    bool  operator!=(const const_iterator& v) const { return !operator==(v); }
+    const_iterator(void): _set(NULL), _block(), _bit(0) {}
+    const_iterator(const HexSet* s, Block block, size_t bit)
+      : _set(s), _block(block), _bit(bit) { seek(); }
+  };
+  typedef const_iterator  iterator;
+  friend class const_iterator;
+
+private:
+  const Grid*                          _grid;  ///< NULL until first insert.
+  std::map<unsigned long long,size_t>  _blocks; ///< Block number -> slot.
+  std::vector<unsigned long long>      _keys;  ///< Block number of each slot.
+  std::vector<Word>                    _words; ///< BLOCK_WORDS for each slot.
+  size_t                               _size;  ///< Number of members.
+
+  unsigned long long  index(const Hex* h) const throw(hex::invalid_argument);
+  const Word*         find(unsigned long long key) const; ///< NULL if none.
+  Word*               block(unsigned long long key); ///< Make it if need be.
+  bool                test(unsigned long long n) const; ///< TRUE iff bit n.
+  bool                set(unsigned long long n); ///< TRUE iff bit n was 0.
+  void                check(const HexSet& v) const
+                        throw(hex::invalid_argument);
+  void                drop(size_t slot); ///< Remove a block.
+  void                prune(void); ///< Drop blocks that have no members.
+
+public:
+  const Grid*     grid(void) const { return _grid; }
+  bool            empty(void) const { return !_size; }
+  size_t          size(void) const { return _size; }
+  size_t          count(const Hex* h) const;
+  bool            contains(const Hex* h) const { return count(h)>0; }
+  /** Membership of hex i,j in grid(). Unlike count(h), this does not need to
+   *  look at the Hex itself. */
+  size_t          count(int i, int j) const;
+  const_iterator  begin(void) const
+                    { return const_iterator(this,_blocks.begin(),0); }
+  const_iterator  end(void) const
+                    { return const_iterator(this,_blocks.end(),0); }
+  std::set<Hex*>  hexes(void) const;
+  /** The members, as sorted runs of hexes. */
+  std::vector<Area::Span>  spans(void) const;
+public: // modification
+  bool     insert(Hex* h) throw(hex::invalid_argument);
+  /** Inserts hex i,j in grid(). */
+  bool     insert(int i, int j) throw(hex::invalid_argument,hex::out_of_range);
+  template<class InputIterator>
+  void     insert(InputIterator first, InputIterator last)
+             { for(; first!=last; ++first) insert(*first); }
+  size_t   erase(Hex* h);
+  /** Removes every member. The set keeps its grid(). */
+  void     clear(void);
+  void     swap(HexSet& v);
+  HexSet&  operator|=(const HexSet& v) throw(hex::invalid_argument);
+  HexSet&  operator&=(const HexSet& v) throw(hex::invalid_argument);
+  HexSet&  operator-=(const HexSet& v) throw(hex::invalid_argument);
+  bool     operator==(const HexSet& v) const;
+  bool     operator!=(const HexSet& v) const { return !operator==(v); }
+public: // construction
+  HexSet(void): _grid(NULL), _blocks(), _keys(), _words(), _size(0) {}
+  explicit HexSet(const std::set<Hex*>& hexes);
+  /** An empty set, for hexes from grid. */
+  explicit HexSet(const Grid& grid)
+    : _grid(&grid), _blocks(), _keys(), _words(), _size(0) {}
+};
+
+
+/** The hexes from r0 to r1 steps (inclusive) from a centre hex, one ring at
+ *  a time, in order of increasing distance. Within each ring, the order is
+ *  the same as range(). Hexes that are off the grid are skipped. If r0>r1,
+ *  then the spiral is empty.
+ *  Iteration is lazy and allocates nothing, so a search that stops early only
+ *  pays for the hexes that it looks at. */
+class Spiral
+{
+public:
+  /** Forward iterator over the hexes in a Spiral. */
+  class const_iterator
+  {
+    const Spiral*  _spiral;
+    size_t         _radius; ///< Current ring. _spiral->_r1+1 at end().
+    int            _side;   ///< Side of the ring, 0-5.
+    size_t         _count;  ///< Steps taken along the side, 1.._radius.
+    int            _i,_j;   ///< Current position.
+    void           start(size_t radius); ///< Go to the ring's first hex.
+    void           next(void); ///< Step on, even if that is off the grid.
+    void           seek(void); ///< Step on until back on the grid, or end().
+  public:
+    typedef std::forward_iterator_tag  iterator_category;
+    typedef Hex*                       value_type;
+    typedef ptrdiff_t                  difference_type;
+    typedef Hex* const*                pointer;
+    typedef Hex*                       reference;
+    Hex*             operator*(void) const;
+    int              i(void) const { return _i; }
+    int              j(void) const { return _j; }
+    size_t           radius(void) const { return _radius; }
+    const_iterator&  operator++(void) { next(); seek(); return *this; }
+    const_iterator   operator++(int)
+                       { const_iterator r(*this); ++*this; return r; }
+    bool  operator==(const const_iterator& v) const
+            { return(_radius==v._radius && _side==v._side &&
+                     _count==v._count); }
+    bool  operator!=(const const_iterator& v) const { return !operator==(v); }
+    const_iterator(void)
+      : _spiral(NULL), _radius(0), _side(0), _count(0), _i(0), _j(0) {}
+    const_iterator(const Spiral* s, size_t radius);
+  };
+  typedef const_iterator  iterator;
+  friend class const_iterator;
+
+private:
+  const Grid*  _grid;
+  int          _i,_j; ///< Centre.
+  size_t       _r0,_r1;
+public:
+  const_iterator  begin(void) const { return const_iterator(this,_r0); }
+  const_iterator  end(void) const { return const_iterator(this,_r1+1); }
+public: // construction
+  Spiral(const Hex* centre, size_t r0, size_t r1);
+};
+
+
+/** The hexes exactly r steps from centre. (See Spiral.) */
+inline Spiral
+ring(const Hex* centre, size_t r)
+{
+  return Spiral(centre,r,r);
+}
+
+
+/** The hexes no more than r steps from centre, nearest first. */
+inline Spiral
+spiral(const Hex* centre, size_t r)
+{
+  return Spiral(centre,0,r);
+}
+
+
+/** The hexes no more than r steps from a centre hex, row by row (increasing
+ *  j, then increasing i). Each row is clipped to the grid before it is
+ *  visited, so off-grid hexes cost nothing. Lazy, and allocates nothing.
+ *  If r<0, then the disc is empty. */
+class Disc
+{
+public:
+  /** Forward iterator over the hexes in a Disc. */
+  class const_iterator
+  {
+    const Disc*  _disc;
+    int          _i,_j; ///< Current position. _j is past the last row at end().
+    int          _i1;   ///< Last hex in the current row.
+    void         row(int j); ///< Go to the first hex in row j, or a later row.
+  public:
+    typedef std::forward_iterator_tag  iterator_category;
+    typedef Hex*                       value_type;
+    typedef ptrdiff_t                  difference_type;
+    typedef Hex* const*                pointer;
+    typedef Hex*                       reference;
+    Hex*             operator*(void) const;
+    int              i(void) const { return _i; }
+    int              j(void) const { return _j; }
+    const_iterator&  operator++(void)
+                       { if(++_i>_i1) row(_j+1); return *this; }
+    const_iterator   operator++(int)
+                       { const_iterator r(*this); ++*this; return r; }
+    bool  operator==(const const_iterator& v) const
+            { return(_i==v._i && _j==v._j); }
+    bool  operator!=(const const_iterator& v) const { return !operator==(v); }
+    const_iterator(void): _disc(NULL), _i(0), _j(0), _i1(0) {}
+    const_iterator(const Disc* d, int j);
+  };
+  typedef const_iterator  iterator;
+  friend class const_iterator;
+
+private:
+  const Grid*  _grid;
+  int          _i,_j; ///< Centre.
+  int          _r;
+  int          _j0,_j1; ///< First & last rows, clipped to the grid.
+public:
+  const_iterator  begin(void) const { return const_iterator(this,_j0); }
+  const_iterator  end(void) const { return const_iterator(this,_j1+1); }
+public: // construction
+  Disc(const Hex* centre, int r);
+};
+
+
+/** A set of hexes that grows & shrinks one hex at a time. Its size and
+ *  perimeter are kept up to date as each hex is added or removed, by looking
+ *  only at that hex's neighbours. (edges() is not: it looks at every member.)
+ *  The number of holes follows from the number of components and the Euler
+ *  characteristic (components - holes), which is also kept up to date
+ *  locally. Components are tracked with a union-find, so adding a hex is
+ *  cheap. Removing a hex is cheap too, unless its neighbours fall into two or
+ *  more separate runs; then it might have cut the region in two. remove()
+ *  then searches out from each run at once, until they meet or all but one
+ *  of them run out. That takes time in proportion to the smaller part cut
+ *  off (or to the shorter way round, if nothing is cut off), but can still
+ *  take as long as counting the whole region. */
+class Region
+{
+  typedef std::tr1::unordered_map<unsigned long long,size_t>  Nodes;
+
+  HexSet                      _hexes;
+  size_t                      _perimeter; ///< Edges of members, facing out.
+  long                        _euler;  ///< components - holes
+  size_t                      _components;
+  Nodes                       _node; ///< Union-find node, by hex position.
+  std::vector<size_t>         _parent;
+
+  unsigned long long  key(const Hex* h) const;
+  void                relabel(void);
+  void                split(Hex* const* seeds, int n);
+public:
+  const Grid*             grid(void) const { return _hexes.grid(); }
+  const HexSet&           hexes(void) const { return _hexes; }
+  size_t                  size(void) const { return _hexes.size(); }
+  bool                    empty(void) const { return _hexes.empty(); }
+  bool                    contains(const Hex* h) const
+                            { return _hexes.contains(h); }
+  /** The edges between members and non-members (or the edge of the grid).
+   *  Unlike perimeter(), this looks at every member. */
+  std::set<Edge*>         edges(void) const;
+  size_t                  perimeter(void) const { return _perimeter; }
+  size_t                  components(void) const { return _components; }
+  size_t                  holes(void) const { return components() - _euler; }
+  bool                    is_connected(void) const
+                            { return components()<=1; }
+  /** The region as an Area. It is an error to call this when
+   *  is_connected()==false */
+  Area                    to_area(void) const;
+public: // modification
+  /** Returns FALSE if h was already a member. */
+  bool  add(Hex* h) throw(hex::invalid_argument);
+  /** Returns FALSE if h was not a member. */
+  bool  remove(Hex* h);
+public: // construction
+  Region(void);
+  explicit Region(const Area& a);
 };
 
 
@@ -401,7 +831,38 @@ public: // construction
 // Algorithms
 
 
-/** Translates coordinates i,j in direction d. */
+/** TRUE iff the library's paranoid checks are switched on. (See
+ *  HEX_PARANOID_CHECKS.) Always FALSE if they are not compiled in. */
+bool
+paranoid_checks(void);
+
+
+/** Switches the library's paranoid checks on or off. Call it before any
+ *  other threads start to use the library. */
+void
+set_paranoid_checks(bool on);
+
+
+/** Axial co-ordinate q of the hex at offset co-ordinates i,j.
+ *  In axial co-ordinates q,r (where r==j) the q-axis runs in direction A and
+ *  the r-axis runs in direction B, so every direction is a constant vector,
+ *  whatever the parity of the row. */
+inline int
+axial_q(int i, int j)
+{
+  return i - (j - (j&1)) / 2;
+}
+
+
+/** Offset co-ordinate i of the hex at axial co-ordinates q,r. */
+inline int
+offset_i(int q, int r)
+{
+  return q + (r - (r&1)) / 2;
+}
+
+
+/** Translates coordinates i,j in direction d. Constant time. */
 void
 go(int& i, int& j, Direction d, size_t distance=1);
 
@@ -422,9 +883,23 @@ size_t
 distance(const Hex* from, const Hex* to);
 
 
+/** The length of the shortest path between coordinates i0,j0 and i1,j1.
+ *  Constant time. */
+inline size_t
+distance(int i0, int j0, int i1, int j1)
+{
+  // Wide enough for the corners of the biggest grids.
+  const long long dq =(long long)axial_q(i1,j1) - axial_q(i0,j0);
+  const long long dr =(long long)j1 - j0;
+  const long long ds =dq + dr;
+  return size_t( ( (dq<0? -dq: dq) + (dr<0? -dr: dr) + (ds<0? -ds: ds) ) / 2 );
+}
+
+
 /** Calculates the set of hexes that are range r from hex h.
  *  The result may NOT be a valid Area, since it may be cut into several
- *  pieces by the edge of the grid. */
+ *  pieces by the edge of the grid. To scan the ring without building a set,
+ *  use ring(h,r). */
 std::set<Hex*>
 range(Hex* h, size_t distance);
 
@@ -444,16 +919,42 @@ std::set<Hex*>
 set_union(const std::set<Hex*>& a, const std::set<Hex*>& b);
 
 
+/** The set difference between a and b. */
+HexSet
+set_difference(const HexSet& a, const HexSet& b) throw(hex::invalid_argument);
+
+
+/** The set intersection between a and b. */
+HexSet
+set_intersection(const HexSet& a, const HexSet& b)
+  throw(hex::invalid_argument);
+
+
+/** The set union between a and b. */
+HexSet
+set_union(const HexSet& a, const HexSet& b) throw(hex::invalid_argument);
+
+
 /** Generates a string representation of hex-set a. */
 std::string
 set_str(const std::set<Hex*>& a);
 
 
+/** Generates a string representation of hex-set a. */
+std::string
+set_str(const HexSet& a);
+
+
 /** Calculate a bounding box for hex-set a. Returns FALSE if a is empty. */
 bool
 bounding_box(const std::set<Hex*>& a, int& i0, int& j0, int& i1, int& j1);
 
 
+/** Calculate a bounding box for hex-set a. Returns FALSE if a is empty. */
+bool
+bounding_box(const HexSet& a, int& i0, int& j0, int& i1, int& j1);
+
+
 /** Calc. the max. area that contains h, but does not intersect beyond. */
 Area
 fill(const std::set<Hex*>& beyond, Hex* h);
@@ -464,9 +965,41 @@ Area
 fill(const std::set<Hex*>& beyond, const Area& a);
 
 
-/** Find all of the Areas (connected sets) in s. */
+/** Calc. the max. area that contains h, but does not intersect beyond. */
+Area
+fill(const HexSet& beyond, Hex* h);
+
+
+/** Max. area that contains hexes in a, but does not intersect beyond. */
+Area
+fill(const HexSet& beyond, const Area& a);
+
+
+/** Connected-component labelling of sorted spans (see Area::spans()).
+ *  Sets labels[n] to the component that contains spans[n]. Components are
+ *  numbered from zero, in order of their first span. Returns the number of
+ *  components. Linear time.
+ *  If threads>1, then the rows are split into that many bands, which are
+ *  labelled in parallel, and then joined at their seams. The result is the
+ *  same for any number of threads. */
+size_t
+label(
+  const std::vector<Area::Span>& spans,
+  std::vector<size_t>&           labels,
+  unsigned                       threads =1
+);
+
+
+/** Find all of the Areas (connected sets) in s. The Areas are in order of
+ *  their first hex (by row, then by column). Labelling uses up to threads
+ *  threads (see label()). */
 std::list<Area>
-areas(const std::set<Hex*>& s);
+areas(const std::set<Hex*>& s, unsigned threads =1);
+
+
+/** Find all of the Areas (connected sets) in s. (See areas(std::set).) */
+std::list<Area>
+areas(const HexSet& s, unsigned threads =1);
 
 
 /** TRUE iff s is connected. (If true, then s can be converted into an Area.) */
@@ -474,6 +1007,75 @@ bool
 is_connected(const std::set<Hex*>& s);
 
 
+/** TRUE iff the sorted spans are connected. Stops as soon as a second
+ *  component is found. */
+bool
+is_connected(const std::vector<Area::Span>& spans);
+
+
+/** TRUE iff s is connected. (If true, then s can be converted into an Area.) */
+bool
+is_connected(const HexSet& s);
+
+
+/** The union of span lists a and b. The result is sorted, and its spans
+ *  never overlap or touch. The arguments must be sorted by Span::operator<. */
+std::vector<Area::Span>
+span_union(const std::vector<Area::Span>& a, const std::vector<Area::Span>& b);
+
+
+/** The intersection of span lists a and b. (See span_union().) */
+std::vector<Area::Span>
+span_intersection(
+  const std::vector<Area::Span>& a,
+  const std::vector<Area::Span>& b
+);
+
+
+/** The span list a, with the hexes in b removed. (See span_union().) */
+std::vector<Area::Span>
+span_difference(
+  const std::vector<Area::Span>& a,
+  const std::vector<Area::Span>& b
+);
+
+
+/** Morphological dilation: the hexes that are no more than r steps from a
+ *  hex in s. A multi-source breadth-first search, so the cost is linear in
+ *  the size of the result, whatever r is. */
+HexSet
+dilate(const HexSet& s, size_t r);
+
+
+/** Morphological erosion: the hexes in s that are more than r steps from
+ *  every hex outside s. The edge of the grid does not count as outside, so
+ *  if s fills the grid, then erosion leaves it unchanged. Linear in the size
+ *  of s. */
+HexSet
+erode(const HexSet& s, size_t r);
+
+
+/** Morphological opening: dilate(erode(s,r),r). Removes parts of s that are
+ *  narrower than 2r+1 hexes. The result is always a subset of s. */
+HexSet
+opening(const HexSet& s, size_t r);
+
+
+/** Morphological closing: erode(dilate(s,r),r). Fills gaps in s that are
+ *  narrower than 2r+1 hexes. Since erode() ignores the edge of the grid,
+ *  the result always contains s. */
+HexSet
+closing(const HexSet& s, size_t r);
+
+
+/** Distance transform of s. result[k] holds the hexes in s that are k+1 steps
+ *  from the nearest hex outside s. (As for erode(), the edge of the grid does
+ *  not count as outside, so if s fills the grid, then the result is empty.)
+ *  Linear in the size of s. */
+std::vector<HexSet>
+distance_layers(const HexSet& s);
+
+
 /** The skeletons of areas a. */
 std::list<Boundary>
 skeleton(const std::list<Area>& a, bool include_boundary =true);
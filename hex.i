@@ -68,6 +68,10 @@ namespace std {
 %ignore hex::operator++;
 %ignore hex::operator--;
 %ignore hex::operator<<;
+%ignore hex::HexSet::const_iterator;
+%ignore hex::HexSet::begin;
+%ignore hex::HexSet::end;
+%ignore hex::Area::Span;
 %ignore FIRETREE__HEXSVG_H;
 %ignore hex::svg::operator<<;
 
@@ -79,7 +83,7 @@ namespace std {
     def __cmp__(self,other):
       return cmp( self.__hash__(), other.__hash__() )
     def __hash__(self):
-      return (self.i << 14) | (self.j)
+      return (self.i << 32) | (self.j)
   %}
 };
 %extend hex::Edge
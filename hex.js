@@ -167,10 +167,14 @@ HEX.Point.prototype = {
  *  objects exist. */
 HEX.Grid = function(cols,rows)
 {
-  if(0>cols || cols>=0x4000)
+  if(0>cols)
       throw HEX.out_of_range("cols");
-  if(0>rows || rows>=0x4000)
+  if(0>rows)
       throw HEX.out_of_range("rows");
+  // Keys must be exact, so Edge keys (Hex key * 10) must fit in a double's
+  // 53-bit mantissa.
+  if(cols*rows*10 >= 0x20000000000000)
+      throw HEX.out_of_range("cols*rows");
   this._hexes = {};
   this.cols = cols;
   this.rows = rows;
@@ -188,6 +192,12 @@ HEX.Grid.prototype = {
       return new HEX.Area(hexes);
     },
 
+  /** Generates a unique key for co-ordinates i,j. */
+  _key : function(i,j)
+    {
+      return this.cols*j + i + 1;
+    },
+
   // factory methods
 
   hex : function(a,b)
@@ -213,11 +223,15 @@ HEX.Grid.prototype = {
     {
       // Parse string of area fillpaths
       // E.g. 1_2>CDE:ABC
+      // ...or of area row spans
+      // E.g. 1_2=0,3;-1,2,1,4
       var result = [];
-      var pos =str.search(/[>:]/);
+      var pos =str.search(/[>:=]/);
       if(pos<0)
           throw HEX.invalid_argument(str+' [1]');
       var origin =this.hex( str.substr(0,pos) );
+      if(str.charAt(pos)==='=')
+          return this._span_area(origin,str.substr(pos+1));
       var start  =origin;
       while(pos>=0)
       {
@@ -238,6 +252,43 @@ HEX.Grid.prototype = {
       return new HEX.Area(result);
     },
 
+  /** Parse the row spans that follow the first hex in an area string. */
+  _span_area : function(origin,str)
+    {
+      var result = [];
+      var rows =str.split(';');
+      var row_i0 =origin.i; // First hex in the previous row.
+      for(var r=0; r<rows.length; ++r)
+      {
+        if(!rows[r].length)
+            continue;
+        var nums =rows[r].split(',');
+        if(nums.length%2)
+            throw HEX.invalid_argument(str);
+        var x =row_i0;
+        for(var n=0; n<nums.length; n+=2)
+        {
+          // parseInt() ignores trailing junk, so check the whole token.
+          // (Grid::area() accepts exactly the same numbers.)
+          if(!/^-?\d+$/.test(nums[n]) || !/^-?\d+$/.test(nums[n+1]))
+              throw HEX.invalid_argument(str);
+          var offset =parseInt(nums[n],10);
+          var length =parseInt(nums[n+1],10);
+          if(length<1)
+              throw HEX.invalid_argument(str);
+          x += offset;
+          if(n===0)
+              row_i0 = x;
+          for(var k=0; k<length; ++k, ++x)
+              result.push( this.hex(x,origin.j+r) );
+        }
+      }
+      if(!result.length)
+          throw HEX.invalid_argument(str);
+      HEX.uniq(result);
+      return new HEX.Area(result);
+    },
+
   /** Parse strings generated by Path::str()
    *  @return  object of type HEX.Path */
   path : function(str)
@@ -439,16 +490,16 @@ HEX.Hex = function(grid,a,b)
     this.i=a;
     this.j=b;
   }
-  // If the grid already contains this hex, then just return a ref.
-  var key=this.valueOf();
-  if(grid._hexes.hasOwnProperty(key))
-      return grid._hexes[key];
-  // else... check bounds.
+  // Check bounds.
   if(0>this.i || this.i>=grid.cols)
       throw HEX.out_of_range("i");
   if(0>this.j || this.j>=grid.rows)
       throw HEX.out_of_range("j");
-  // Register this new Hex.
+  // If the grid already contains this hex, then just return a ref.
+  var key=grid._key(this.i,this.j);
+  if(grid._hexes.hasOwnProperty(key))
+      return grid._hexes[key];
+  // else... register this new Hex.
   grid._hexes[key] = this;
   this.grid = grid;
 }
@@ -523,9 +574,11 @@ HEX.Hex.prototype = {
       {
         return this.grid.hex( pos.i, pos.j );
       }
-      catch(e if e instanceof HEX.exception && e.kind=='out_of_range')
+      catch(e)
       {
-        return null;
+        if(e instanceof HEX.exception && e.kind=='out_of_range')
+            return null;
+        throw e;
       }
     },
 
@@ -536,7 +589,7 @@ HEX.Hex.prototype = {
 
   valueOf : function()
     {
-      return 0x4000*this.i + this.j + 1;
+      return this.grid._key(this.i,this.j);
     }
 
 };
@@ -44,6 +44,8 @@ public:
 
 typedef double Cost;
 
+class SearchContext;
+
 
 /** Models movement costs in a hex grid. */
 class Topography
@@ -57,11 +59,62 @@ class Topography
    *  *Over-rides* the normal costs. Must pay the cost of the 
    *  DESTINATION hex's edge. */
   std::map<hex::Edge*,Cost>  _edges;
+  /** No step costs less than this. */
+  Cost                       _min_cost;
+  void lower_min_cost(Cost c) { if(c < _min_cost) _min_cost = c; }
+
+  /** The grid that the flat arrays below were compiled for, or NULL. */
+  const hex::Grid*            _grid;
+  /** Cost to enter each hex. key: Grid index (i + j * cols) */
+  std::vector<Cost>           _hex_cost;
+  /** Cost to enter each hex across each of its edges. key: index*6 + dir */
+  std::vector<Cost>           _edge_cost;
+  /** Bit d: edge d of the hex has a cost. Bit PASSABLE: the hex has a cost. */
+  std::vector<unsigned char>  _flags;
+  enum { PASSABLE = 1<<DIRECTIONS };
+
+  /** The grid that the reachability index was built for, or NULL. */
+  const hex::Grid*            _reach_grid;
+  /** Component label of each hex, which is the index of one of its members.
+   *  key: Grid index (i + j * cols) */
+  std::vector<size_t>         _component;
+  /** Circular linked list of the members of each component. */
+  std::vector<size_t>         _next;
+  /** Number of members. key: component label */
+  std::vector<size_t>         _members;
+  /** TRUE iff a hex has a cost, or an edge cost. Only these hexes are ever
+   *  joined to their neighbours. key: Grid index */
+  std::vector<bool>           _enterable;
+
+  size_t reach_index(const hex::Hex* h) const
+    { return size_t(h->i) + size_t(h->j) * size_t(_reach_grid->cols()); }
+  /** Joins the components of neighbouring hexes a & b in the index. */
+  void join(const hex::Hex* a, const hex::Hex* b);
+  /** Joins h to its neighbours, after it gains a cost or an edge cost. */
+  void join_hex(hex::Hex* h);
 public:
   Topography();
   Topography(Cost default_hex_cost);
   virtual ~Topography() {}
   
+  /** Copies the costs of the hexes in grid into flat arrays, so that
+   *  searches in grid need no map look-ups. Any later change to the costs
+   *  throws the arrays away again, until the next call to compile(). */
+  void compile(const hex::Grid& grid);
+  /** TRUE iff compile() has been called since the last change in costs. */
+  bool is_compiled(void) const { return _grid!=NULL; }
+
+  /** Builds an index of which hexes in grid are connected to each other.
+   *  Later changes in costs keep the index up to date. compile() builds it
+   *  too, unless it has already been built for grid. */
+  void index_reachability(const hex::Grid& grid);
+  /** FALSE if there is certainly no route from a to b. Takes constant time
+   *  once index_reachability() has been called for their grid. Otherwise
+   *  always TRUE.
+   *  (Edge costs can make one-way routes, so TRUE only means that a & b are
+   *  joined by moves in one direction or the other.) */
+  bool is_reachable(const hex::Hex* a, const hex::Hex* b) const;
+
   /** Calculate set of accessible hexes. */
   std::set<hex::Hex*> accessible(void) const;
 
@@ -86,9 +139,39 @@ public:
   /** Finds the least-cost hex::Path from start to goal.
    *  Uses the A* algorithm. */
   hex::Path best_path(hex::Hex* start, hex::Hex* goal) const throw(no_solution);
+  /** Finds the least-cost hex::Path from start to goal, using (and
+   *  re-using) the working memory in context. */
+  hex::Path best_path(
+      hex::Hex*       start,
+      hex::Hex*       goal,
+      SearchContext&  context
+    ) const throw(no_solution);
+
+  /** Finds the least-cost hex::Path from start to goal, searching from
+   *  both ends at once until the searches meet. Uses the A* algorithm.
+   *  On open ground, long routes take far fewer steps than best_path(),
+   *  but mazes may take more. The path is optimal even if some steps cost
+   *  less than the distance they cover. */
+  hex::Path best_path_bidirectional(hex::Hex* start, hex::Hex* goal) const
+    throw(no_solution);
+  /** As above, using (and re-using) the working memory in two contexts, one
+   *  for each direction. */
+  hex::Path best_path_bidirectional(
+      hex::Hex*       start,
+      hex::Hex*       goal,
+      SearchContext&  forward,
+      SearchContext&  backward
+    ) const throw(no_solution);
 
   /** Finds the hex::Area that can be reached from start with budget. */
   hex::Area horizon(hex::Hex* start, Cost budget) const throw(no_solution);
+  /** Finds the hex::Area that can be reached from start with budget, using
+   *  (and re-using) the working memory in context. */
+  hex::Area horizon(
+      hex::Hex*       start,
+      Cost            budget,
+      SearchContext&  context
+    ) const throw(no_solution);
 
 protected:
   struct Step
@@ -104,6 +187,135 @@ protected:
 };
 
 
+/** Working memory for the routing algorithms: the open list, and the
+ *  state, cost and parent of each hex that a search reaches.
+ *  Re-using one context for many searches saves allocating this memory
+ *  each time. Starting a new search takes constant time, unless the grid is
+ *  bigger than any seen before. A context may only be used by one thread at
+ *  a time, so keep one per thread.
+ *  A default context keeps its hexes in a hash table, so each search costs
+ *  time in proportion to the hexes it explores. A context that is sized
+ *  for a grid keeps a flat array with room for every hex instead, which is
+ *  faster for long searches, but costs memory in proportion to the grid.
+ */
+class SearchContext
+{
+public:
+  SearchContext(void);
+  /** Sizes the context for searches in grid, with a flat array. */
+  SearchContext(const hex::Grid& grid);
+
+  /** An offer to reach node at cost, from parent. */
+  struct Entry
+    {
+      Cost           value;  ///< cost + distance to goal          (f() in A*)
+      unsigned long  seq;    ///< Insertion order, breaks ties in value.
+      size_t         node;
+      size_t         parent;
+      Cost           cost;   ///< sum of weights of hexes in path. (g() in A*)
+    };
+
+  /** Forgets the previous search, and starts another in grid.
+   *  The heuristic is the distance to goal, or zero if goal is NULL.
+   *  For searches that start from both ends, set origin to the other end,
+   *  and min_step to the least cost of any step. Then the heuristic is
+   *  half of (steps to goal - steps to origin) * min_step, which both
+   *  searches agree upon, and ties go to the longest route. */
+  void start(
+      const hex::Grid&  grid,
+      hex::Hex*         goal =NULL,
+      hex::Hex*         origin =NULL,
+      Cost              min_step =0
+    );
+
+  /** Offers a route to h, via parent, with total cost. */
+  void push(hex::Hex* h, size_t parent, Cost cost);
+  /** Closes the next cheapest node, and sets e to its winning offer.
+   *  Returns FALSE when there are no more open nodes. */
+  bool pop(Entry& e);
+  /** Sets value to that of the next cheapest open node, without closing it.
+   *  Returns FALSE when there are no more open nodes. */
+  bool peek(Cost& value);
+  /** The hexes from the start to closed node n, following parent links. */
+  std::list<hex::Hex*> path(size_t n) const;
+
+  size_t index(const hex::Hex* h) const
+    { return size_t(h->i) + size_t(h->j) * _cols; }
+  hex::Hex* hex(size_t n) const
+    { return _grid->hex( int(n % _cols), int(n / _cols) ); }
+  bool is_closed(size_t n) const
+    { const Slot* s =find(n); return s && s->stamp==closed_stamp(); }
+  /** TRUE iff node n has been offered a route, in this search. */
+  bool has_cost(size_t n) const { return find(n)!=NULL; }
+  /** The cost of the best route yet to node n (for which has_cost()). */
+  Cost cost(size_t n) const { return find(n)->cost; }
+
+private:
+  /** When the generation wraps round, start() clears every stamp. Stamps
+   *  are wide, so that almost never happens. */
+  typedef unsigned long Stamp;
+
+  /** The state of one node. */
+  struct Slot
+    {
+      size_t         node;   ///< Only used by the hash table.
+      Stamp          stamp;
+      Cost           cost;
+      size_t         parent;
+    };
+
+  /** Heap order: lowest value first, then (if deep) highest cost, then
+   *  first in, first out. */
+  struct Later
+    {
+      bool operator()(const Entry& a, const Entry& b) const
+        {
+          if(a.value!=b.value)
+              return a.value > b.value;
+          if(deep && a.cost!=b.cost)
+              return a.cost < b.cost;
+          return a.seq > b.seq;
+        }
+      Later(bool d): deep(d) {}
+      bool deep; ///< Break ties in favour of the longest route.
+    };
+
+  Stamp open_stamp(void) const   { return Stamp(2 * _generation); }
+  Stamp closed_stamp(void) const { return Stamp(2 * _generation + 1); }
+
+  /** The slot of node n, or NULL if n has no cost in this search. */
+  const Slot* find(size_t n) const;
+  /** The slot of node n, which is new (and unstamped) if n has no cost in
+   *  this search. The caller must stamp new slots. */
+  Slot& demand(size_t n);
+  /** First place to look for node n in the hash table. */
+  size_t bucket(size_t n) const
+    { return size_t( (n * 0x9E3779B97F4A7C15ULL) >> (64 - _bits) ); }
+  /** Doubles the size of the hash table. */
+  void grow(void);
+
+  const hex::Grid*            _grid;
+  size_t                      _cols;
+  hex::Hex*                   _goal;
+  hex::Hex*                   _origin;
+  Cost                        _min_step;
+  /** Incremented by start(). Older stamps mean a node is unseen. */
+  Stamp                       _generation;
+  /** After this generation, start() wraps round. Only tests lower it. */
+  Stamp                       _last_generation;
+  friend struct SearchContextTest;
+  unsigned long               _seq;
+  /** TRUE: _slots is indexed by node. FALSE: _slots is a hash table. */
+  bool                        _dense;
+  /** log2 of the size of the hash table. */
+  int                         _bits;
+  /** Number of slots in the hash table that are used in this search. */
+  size_t                      _used;
+  std::vector<Slot>           _slots;
+  std::vector<Entry>          _heap;
+};
+
+
 /** A partial solution to the A* algorithm.
  *  Only used in the internal workings of the routing algorithms. You won't
  *  need this class unless you are writing your own routing algorithms.
@@ -0,0 +1,408 @@
+/*                            Package   : libhex
+ * hexset.cc                  Created   : 2026/10/16
+ *                            Author    : Alex Tingle
+ *
+ *    Copyright (C) 2007-2010, Alex Tingle.
+ *
+ *    This file is part of the libhex application.
+ *
+ *    libhex is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Lesser General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 2.1 of the License, or (at your option) any later version.
+ *
+ *    libhex is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *    Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with this library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "hex.h"
+
+#include <algorithm>
+
+namespace hex {
+
+
+namespace {
+
+typedef HexSet::Word Word;
+
+/** Helper: TRUE iff the block starting at w has no members. */
+inline bool
+is_empty(const Word* w)
+{
+  for(int k=0; k<HexSet::BLOCK_WORDS; ++k)
+      if(w[k])
+          return false;
+  return true;
+}
+
+
+/** Helper: the number of members in the block starting at w. */
+inline size_t
+population(const Word* w)
+{
+  size_t result =0;
+  for(int k=0; k<HexSet::BLOCK_WORDS; ++k)
+      result += __builtin_popcountll(w[k]);
+  return result;
+}
+
+} // end anonymous namespace
+
+
+//
+// HexSet::const_iterator
+
+void
+HexSet::const_iterator::seek(void)
+{
+  for(; _block!=_set->_blocks.end(); ++_block, _bit=0)
+  {
+    const Word* w =&_set->_words[_block->second * BLOCK_WORDS];
+    for(size_t k=_bit/WORD_BITS; k<BLOCK_WORDS; ++k)
+    {
+      Word bits =w[k];
+      if(k==_bit/WORD_BITS)
+          bits &= ~Word(0) << (_bit % WORD_BITS);
+      if(bits)
+      {
+        _bit = k * WORD_BITS + __builtin_ctzll(bits);
+        return;
+      }
+    }
+  }
+  _bit=0; // end()
+}
+
+
+Hex*
+HexSet::const_iterator::operator*(void) const
+{
+  const unsigned long long n =_block->first * BLOCK_BITS + _bit;
+  const unsigned long long cols =_set->_grid->cols();
+  return _set->_grid->hex( int(n % cols), int(n / cols) );
+}
+
+
+//
+// HexSet
+
+unsigned long long
+HexSet::index(const Hex* h) const throw(hex::invalid_argument)
+{
+  if(!h)
+      throw hex::invalid_argument("HexSet: NULL hex");
+  if(_grid && _grid!=&h->grid())
+      throw hex::invalid_argument("HexSet: hex from another grid");
+  return (unsigned long long)(h->i) +
+         (unsigned long long)(h->j) * (unsigned long long)(h->grid().cols());
+}
+
+
+const HexSet::Word*
+HexSet::find(unsigned long long key) const
+{
+  std::map<unsigned long long,size_t>::const_iterator pos =_blocks.find(key);
+  if(pos==_blocks.end())
+      return NULL;
+  return &_words[pos->second * BLOCK_WORDS];
+}
+
+
+HexSet::Word*
+HexSet::block(unsigned long long key)
+{
+  // Sets are usually built in order, so new blocks tend to go at the end.
+  std::map<unsigned long long,size_t>::iterator pos =_blocks.end();
+  if(!_blocks.empty() && key<=_blocks.rbegin()->first)
+      pos = _blocks.lower_bound(key);
+  if(pos==_blocks.end() || pos->first!=key)
+  {
+    // New blocks are appended, so making one costs the same in any order.
+    pos = _blocks.insert(pos, std::make_pair(key,_keys.size()));
+    _keys.push_back(key);
+    _words.resize(_words.size() + BLOCK_WORDS, Word(0));
+  }
+  return &_words[pos->second * BLOCK_WORDS];
+}
+
+
+void
+HexSet::check(const HexSet& v) const throw(hex::invalid_argument)
+{
+  if(_grid && v._grid && _grid!=v._grid)
+      throw hex::invalid_argument("HexSet: sets from different grids");
+}
+
+
+void
+HexSet::drop(size_t slot)
+{
+  // Move the last block into the hole, so that the others stay put.
+  const size_t last =_keys.size() - 1;
+  _blocks.erase(_keys[slot]);
+  if(slot!=last)
+  {
+    _keys[slot] = _keys[last];
+    _blocks[_keys[slot]] = slot;
+    std::copy( &_words[last * BLOCK_WORDS], &_words[last * BLOCK_WORDS] +
+               BLOCK_WORDS, &_words[slot * BLOCK_WORDS] );
+  }
+  _keys.pop_back();
+  _words.resize(last * BLOCK_WORDS);
+}
+
+
+void
+HexSet::prune(void)
+{
+  _size = 0;
+  for(size_t b=_keys.size(); b--; ) // Backwards, as drop() moves the last.
+  {
+    const Word* w =&_words[b * BLOCK_WORDS];
+    if(is_empty(w))
+        drop(b);
+    else
+        _size += population(w);
+  }
+}
+
+
+bool
+HexSet::test(unsigned long long n) const
+{
+  const Word* w =find(n / BLOCK_BITS);
+  if(!w)
+      return false;
+  const size_t bit =n % BLOCK_BITS;
+  return (w[bit / WORD_BITS] >> (bit % WORD_BITS)) & 1;
+}
+
+
+bool
+HexSet::set(unsigned long long n)
+{
+  const size_t bit =n % BLOCK_BITS;
+  Word& w =block(n / BLOCK_BITS)[bit / WORD_BITS];
+  const Word mask =Word(1) << (bit % WORD_BITS);
+  if(w & mask)
+      return false;
+  w |= mask;
+  ++_size;
+  return true;
+}
+
+
+size_t
+HexSet::count(const Hex* h) const
+{
+  if(!h || !_grid || _grid!=&h->grid())
+      return 0;
+  return test( index(h) );
+}
+
+
+size_t
+HexSet::count(int i, int j) const
+{
+  if(!_grid || !_grid->is_in_range(i,j))
+      return 0;
+  return test( (unsigned long long)(i) +
+               (unsigned long long)(j) * (unsigned long long)(_grid->cols()) );
+}
+
+
+std::set<Hex*>
+HexSet::hexes(void) const
+{
+  std::set<Hex*> result;
+  for(const_iterator h=begin(); h!=end(); ++h)
+      result.insert(*h);
+  return result;
+}
+
+
+std::vector<Area::Span>
+HexSet::spans(void) const
+{
+  std::vector<Area::Span> result;
+  if(!_grid)
+      return result;
+  const unsigned long long cols =_grid->cols();
+  std::map<unsigned long long,size_t>::const_iterator b;
+  for(b=_blocks.begin(); b!=_blocks.end(); ++b)
+    for(size_t k=0; k<BLOCK_WORDS; ++k)
+      for(Word bits=_words[b->second*BLOCK_WORDS+k]; bits; bits&=bits-1)
+      {
+        const unsigned long long n =
+          b->first * BLOCK_BITS + k * WORD_BITS + __builtin_ctzll(bits);
+        const int i =int(n % cols);
+        const int j =int(n / cols);
+        if(!result.empty() && result.back().j==j && result.back().i1+1==i)
+            result.back().i1 = i;
+        else
+            result.push_back( Area::Span(j,i,i) );
+      }
+  return result;
+}
+
+
+bool
+HexSet::insert(Hex* h) throw(hex::invalid_argument)
+{
+  const unsigned long long n =index(h);
+  if(!_grid)
+      _grid = &h->grid();
+  return set(n);
+}
+
+
+bool
+HexSet::insert(int i, int j) throw(hex::invalid_argument,hex::out_of_range)
+{
+  if(!_grid)
+      throw hex::invalid_argument("HexSet::insert: no grid");
+  if(!_grid->is_in_range(i,j))
+      throw hex::out_of_range("HexSet::insert");
+  return set( (unsigned long long)(i) +
+              (unsigned long long)(j) * (unsigned long long)(_grid->cols()) );
+}
+
+
+size_t
+HexSet::erase(Hex* h)
+{
+  if(!count(h))
+      return 0;
+  const unsigned long long n =index(h);
+  const size_t slot =_blocks.find(n / BLOCK_BITS)->second;
+  Word* w =&_words[slot * BLOCK_WORDS];
+  const size_t bit =n % BLOCK_BITS;
+  w[bit / WORD_BITS] &= ~(Word(1) << (bit % WORD_BITS));
+  --_size;
+  if(is_empty(w))
+      drop(slot);
+  return 1;
+}
+
+
+void
+HexSet::clear(void)
+{
+  _blocks.clear();
+  _keys.clear();
+  _words.clear();
+  _size = 0;
+}
+
+
+void
+HexSet::swap(HexSet& v)
+{
+  std::swap(_grid,v._grid);
+  _blocks.swap(v._blocks);
+  _keys.swap(v._keys);
+  _words.swap(v._words);
+  std::swap(_size,v._size);
+}
+
+
+HexSet&
+HexSet::operator|=(const HexSet& v) throw(hex::invalid_argument)
+{
+  check(v);
+  if(v.empty())
+      return *this;
+  if(empty())
+      return *this = v;
+  std::map<unsigned long long,size_t>::const_iterator b;
+  for(b=v._blocks.begin(); b!=v._blocks.end(); ++b)
+  {
+    Word* wa =block(b->first);
+    const Word* wb =&v._words[b->second * BLOCK_WORDS];
+    _size -= population(wa);
+    for(int k=0; k<BLOCK_WORDS; ++k)
+        wa[k] |= wb[k];
+    _size += population(wa);
+  }
+  return *this;
+}
+
+
+HexSet&
+HexSet::operator&=(const HexSet& v) throw(hex::invalid_argument)
+{
+  check(v);
+  // Blocks that are not in v become empty, and are pruned.
+  for(size_t a=0; a<_keys.size(); ++a)
+  {
+    Word* wa =&_words[a * BLOCK_WORDS];
+    const Word* wb =v.find(_keys[a]);
+    if(wb)
+        for(int k=0; k<BLOCK_WORDS; ++k)
+            wa[k] &= wb[k];
+    else
+        std::fill(wa, wa+BLOCK_WORDS, Word(0));
+  }
+  prune();
+  return *this;
+}
+
+
+HexSet&
+HexSet::operator-=(const HexSet& v) throw(hex::invalid_argument)
+{
+  check(v);
+  for(size_t a=0; a<_keys.size(); ++a)
+  {
+    const Word* wb =v.find(_keys[a]);
+    if(wb)
+    {
+      Word* wa =&_words[a * BLOCK_WORDS];
+      for(int k=0; k<BLOCK_WORDS; ++k)
+          wa[k] &= ~wb[k];
+    }
+  }
+  prune();
+  return *this;
+}
+
+
+bool
+HexSet::operator==(const HexSet& v) const
+{
+  if(empty() || v.empty())
+      return( empty() && v.empty() );
+  if(_grid!=v._grid || _size!=v._size || _keys.size()!=v._keys.size())
+      return false;
+  // Neither set keeps empty blocks, so the same members means the same keys.
+  for(size_t a=0; a<_keys.size(); ++a)
+  {
+    const Word* wa =&_words[a * BLOCK_WORDS];
+    const Word* wb =v.find(_keys[a]);
+    if(!wb || !std::equal(wa, wa+BLOCK_WORDS, wb))
+        return false;
+  }
+  return true;
+}
+
+
+HexSet::HexSet(const std::set<Hex*>& hexes)
+  : _grid(NULL), _blocks(), _keys(), _words(), _size(0)
+{
+  for(std::set<Hex*>::const_iterator h=hexes.begin(); h!=hexes.end(); ++h)
+  {
+    const unsigned long long n =index(*h);
+    _grid = &(**h).grid();
+    set(n);
+  }
+}
+
+
+} // end namespace hex
@@ -25,7 +25,10 @@
 #define FIRETREE__HEX__INTERNAL_H 1
 
 
+#include "hex.h"
+
 #include <list>
+#include <vector>
 
 namespace hex {
 
@@ -46,6 +49,96 @@ inline bool size_greater(const std::list<T> L, size_t N)
 }
 
 
+/** Hexes i0..i1 in row j touch (i0-1)..i1 in the rows above & below when j
+ *  is even, and i0..(i1+1) when j is odd. Sets lo..hi to the columns that
+ *  span s touches, which may run one column off either side of the grid. */
+inline void touching(const Area::Span& s, int& lo, int& hi)
+{
+  lo = (s.j&1)? s.i0: s.i0-1;
+  hi = (s.j&1)? s.i1+1: s.i1;
+}
+
+
+/** The root of n's tree in a union-find forest. */
+inline size_t find_root(std::vector<size_t>& parent, size_t n)
+{
+  while(parent[n]!=n)
+  {
+    parent[n] = parent[parent[n]]; // Path halving.
+    n = parent[n];
+  }
+  return n;
+}
+
+
+/** Atomically reads pointer *p. Pairs with install(), so that the object
+ *  pointed to is seen fully constructed by every thread. */
+template<typename T>
+inline T* atomic_load(T* const* p)
+{
+  return __atomic_load_n(p,__ATOMIC_ACQUIRE);
+}
+
+
+/** Atomically sets *p to v. Pairs with atomic_load(). */
+template<typename T>
+inline void atomic_store(T** p, T* v)
+{
+  __atomic_store_n(p,v,__ATOMIC_RELEASE);
+}
+
+
+/** Atomically sets *p to v, but only if *p is still equal to expected.
+ *  Returns FALSE if another thread got there first. */
+template<typename T>
+inline bool compare_and_swap(T** p, T* expected, T* v)
+{
+  return __atomic_compare_exchange_n(
+      p, &expected, v, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE
+    );
+}
+
+
+/** Atomically reads index *p. */
+inline size_t atomic_load(const size_t* p)
+{
+  return __atomic_load_n(p,__ATOMIC_ACQUIRE);
+}
+
+
+/** Atomically sets *p to v, but only if *p is still equal to expected.
+ *  Returns FALSE if another thread got there first. */
+inline bool compare_and_swap(size_t* p, size_t expected, size_t v)
+{
+  return __atomic_compare_exchange_n(
+      p, &expected, v, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE
+    );
+}
+
+
+/** Atomically adds one to counter *p. */
+inline void atomic_increment(size_t* p)
+{
+  __atomic_add_fetch(p,1,__ATOMIC_RELAXED);
+}
+
+
+/** Atomically subtracts one from counter *p. Returns the new count. */
+inline size_t atomic_decrement(size_t* p)
+{
+  return __atomic_sub_fetch(p,1,__ATOMIC_ACQ_REL);
+}
+
+
+/** Atomically sets *p to v, but only if *p is still NULL.
+ *  Returns FALSE if another thread got there first. */
+template<typename T>
+inline bool install(T** p, T* v)
+{
+  return compare_and_swap(p,static_cast<T*>(NULL),v);
+}
+
+
 } // end namespace hex
 
 
@@ -23,7 +23,9 @@
 
 #include "hexmove.h"
 
+#include <algorithm>
 #include <cmath>
+#include <limits>
 
 
 namespace hex {
@@ -31,15 +33,146 @@ namespace move {
 
 
 Topography::Topography()
-  : _has_default(false), _default(0.0), _hexes(), _edges()
+  : _has_default(false), _default(0.0), _hexes(), _edges(),
+    _min_cost(std::numeric_limits<Cost>::max()),
+    _grid(NULL), _hex_cost(), _edge_cost(), _flags(),
+    _reach_grid(NULL), _component(), _next(), _members(), _enterable()
   {}
 
 
 Topography::Topography(Cost default_hex_cost)
-  : _has_default(true), _default(default_hex_cost), _hexes(), _edges()
+  : _has_default(true), _default(default_hex_cost), _hexes(), _edges(),
+    _min_cost(default_hex_cost),
+    _grid(NULL), _hex_cost(), _edge_cost(), _flags(),
+    _reach_grid(NULL), _component(), _next(), _members(), _enterable()
   {}
 
 
+void
+Topography::compile(const hex::Grid& grid)
+{
+  const size_t cols =grid.cols();
+  const size_t size =cols * size_t(grid.rows());
+  _hex_cost.assign(size,_default);
+  _edge_cost.assign(size * DIRECTIONS,0.0);
+  _flags.assign(size,( _has_default? (unsigned char)PASSABLE: 0 ));
+  for(std::map<hex::Hex*,Cost>::const_iterator i=_hexes.begin(); i!=_hexes.end();++i)
+    if(&i->first->grid()==&grid)
+    {
+      const size_t n =size_t(i->first->i) + size_t(i->first->j) * cols;
+      _hex_cost[n] = i->second;
+      _flags[n] |= PASSABLE;
+    }
+  for(std::map<hex::Edge*,Cost>::const_iterator i=_edges.begin();i!=_edges.end();++i)
+  {
+    const hex::Hex* h =i->first->hex();
+    if(&h->grid()==&grid)
+    {
+      const size_t n =size_t(h->i) + size_t(h->j) * cols;
+      const int d =i->first->direction();
+      _edge_cost[n * DIRECTIONS + d] = i->second;
+      _flags[n] |= (unsigned char)(1<<d);
+    }
+  }
+  _grid = &grid;
+  if(_reach_grid!=&grid)
+      index_reachability(grid);
+}
+
+
+void
+Topography::index_reachability(const hex::Grid& grid)
+{
+  // Every hex starts alone in its own component.
+  const size_t size =size_t(grid.cols()) * size_t(grid.rows());
+  _component.resize(size);
+  _next.resize(size);
+  for(size_t n=0; n<size; ++n)
+      _component[n] = _next[n] = n;
+  _members.assign(size,1);
+  _enterable.assign(size,_has_default);
+  _reach_grid = &grid;
+  for(std::map<hex::Hex*,Cost>::const_iterator i=_hexes.begin(); i!=_hexes.end();++i)
+    if(&i->first->grid()==&grid)
+        _enterable[ reach_index(i->first) ] = true;
+  for(std::map<hex::Edge*,Cost>::const_iterator i=_edges.begin();i!=_edges.end();++i)
+    if(&i->first->hex()->grid()==&grid)
+        _enterable[ reach_index(i->first->hex()) ] = true;
+  for(int j=0; j<grid.rows(); ++j)
+    for(int i=0; i<grid.cols(); ++i)
+    {
+      hex::Hex* h =grid.hex(i,j);
+      if(!_enterable[ reach_index(h) ])
+          continue;
+      for(int dir=0; dir<DIRECTIONS; ++dir)
+      {
+        Topography::Step s = step(h,hex::A+dir);
+        if(s.to_hex && _enterable[ reach_index(s.to_hex) ])
+            join(h,s.to_hex);
+      }
+    }
+}
+
+
+bool
+Topography::is_reachable(const hex::Hex* a, const hex::Hex* b) const
+{
+  if(a==b || !_reach_grid || &a->grid()!=_reach_grid || &b->grid()!=_reach_grid)
+      return true;
+  const size_t nb =reach_index(b);
+  if(!_enterable[nb])
+      return false;
+  // a itself need not be enterable, so look at where its first step might go.
+  // Hexes that can't be entered are alone in their components.
+  for(int d=0; d<DIRECTIONS; ++d)
+  {
+    const hex::Hex* ad =a->go(hex::A+d);
+    if(ad && _component[ reach_index(ad) ]==_component[nb])
+        return true;
+  }
+  return false;
+}
+
+
+void
+Topography::join(const hex::Hex* a, const hex::Hex* b)
+{
+  size_t na =reach_index(a);
+  size_t nb =reach_index(b);
+  if(_component[na]==_component[nb])
+      return;
+  // Relabel the smaller component, so that labels can be read in one step.
+  if(_members[_component[na]] < _members[_component[nb]])
+      std::swap(na,nb);
+  const size_t label =_component[na];
+  _members[label] += _members[_component[nb]];
+  size_t n =nb;
+  do{
+    _component[n] = label;
+    n = _next[n];
+  }while(n!=nb);
+  std::swap(_next[na],_next[nb]); // Splice the member lists together.
+}
+
+
+void
+Topography::join_hex(hex::Hex* h)
+{
+  if(&h->grid()!=_reach_grid)
+      return;
+  _enterable[ reach_index(h) ] = true;
+  for(int d=0; d<DIRECTIONS; ++d)
+  {
+    hex::Hex* hd =h->go(hex::A+d);
+    if(hd && _enterable[ reach_index(hd) ] &&
+       ( step(h,hex::A+d).to_hex || step(hd,hex::A+d+3).to_hex ))
+    {
+      join(h,hd);
+    }
+  }
+}
+
+
 std::set<hex::Hex*>
 Topography::accessible(void) const
 {
@@ -56,50 +189,60 @@ Topography::accessible(void) const
 void
 Topography::increase_hex_cost(hex::Hex* h, Cost c)
 {
+  _grid = NULL;
   {
     std::map<hex::Hex*,Cost>::iterator pos = _hexes.find(h);
     if(pos==_hexes.end())
-        _hexes[h] = _default + c;
-    else
-        pos->second += c;
+        pos = _hexes.insert( std::make_pair(h,_default) ).first;
+    pos->second += c;
+    lower_min_cost(pos->second);
   }
   for(int d=0; d<DIRECTIONS; ++d)
   {
     hex::Edge* e =h->edge(hex::A+d);
     std::map<hex::Edge*,Cost>::iterator pos = _edges.find(e);
     if(pos!=_edges.end())
-        pos->second += c;
+    {
+      pos->second += c;
+      lower_min_cost(pos->second);
+    }
   }
+  join_hex(h);
 }
 
 
 void
 Topography::override_hex_cost(hex::Hex* h, Cost c)
 {
+  _grid = NULL;
   _hexes[h] = c;
+  lower_min_cost(c);
   for(int d=0; d<DIRECTIONS; ++d)
   {
     hex::Edge* e =h->edge(hex::A+d);
     _edges.erase(e);
   }
+  join_hex(h);
 }
       
 void Topography::increase_edge_cost(hex::Edge* e, Cost c)
 {
   if(!e)
     return;
+  _grid = NULL;
   std::map<hex::Edge*,Cost>::iterator epos = _edges.find(e);
   if(epos==_edges.end())
   {
     std::map<hex::Hex*,Cost>::iterator hpos = _hexes.find( e->hex() );
     if(hpos!=_hexes.end())
-      _edges[e] = hpos->second + c;
+      lower_min_cost( _edges[e] = hpos->second + c );
     else if(_has_default)
-      _edges[e] = _default + c;
+      lower_min_cost( _edges[e] = _default + c );
   }
   else
   {
     epos->second += c;
+    lower_min_cost(epos->second);
   }
 }
 
@@ -107,8 +250,12 @@ void Topography::increase_edge_cost(hex::Edge* e, Cost c)
 void
 Topography::override_edge_cost(hex::Edge* e, Cost c)
 {
-  if(e)
-    _edges[e] = c;
+  if(!e)
+    return;
+  _grid = NULL;
+  _edges[e] = c;
+  lower_min_cost(c);
+  join_hex(e->hex()); // Can now be entered across e.
 }
 
 
@@ -160,57 +307,192 @@ Topography::override_cost(const hex::Boundary& b, Cost c)
 }
 
 
+namespace {
+
+/** Helper: Straight-line distance from h to goal, if any.
+ *  Used for the h() heuristic function in A* algorithm. */
+inline hex::Distance
+heuristic(const hex::Hex* h, const hex::Hex* goal)
+{
+  if(goal)
+  {
+    hex::Point vector = goal->centre() - h->centre();
+    return sqrt( vector.x * vector.x  +  vector.y * vector.y );
+  }
+  return 0;
+}
+
+
+} // end anonymous namespace
+
+
 hex::Path
 Topography::best_path(hex::Hex* start, hex::Hex* goal) const throw(no_solution)
 {
-  std::set<hex::Hex*> visited;
-  std::multiset<_Route> queue;
-  queue.insert( _Route::factory(start,goal) );
-  while(!queue.empty())
+  SearchContext context;
+  return best_path(start,goal,context);
+}
+
+
+hex::Path
+Topography::best_path(
+    hex::Hex*       start,
+    hex::Hex*       goal,
+    SearchContext&  context
+  ) const throw(no_solution)
+{
+  if(goal && !is_reachable(start,goal))
+      throw no_solution("best_path");
+  context.start(start->grid(),goal);
+  const size_t target =( goal? context.index(goal): size_t(-1) );
+  context.push(start,context.index(start),0);
+  SearchContext::Entry curr;
+  while(context.pop(curr))
   {
-    _Route curr_route = *queue.begin();
-    queue.erase( queue.begin() );
-    hex::Hex* curr_hex = curr_route.path.back();
-    if(visited.count(curr_hex))
-        continue;
-    if(curr_hex==goal)
-        return hex::Path(curr_route.path);
-    visited.insert(curr_hex);
+    if(curr.node==target)
+        return hex::Path(context.path(curr.node));
+    hex::Hex* curr_hex = context.hex(curr.node);
     for(int dir=0; dir<DIRECTIONS; ++dir)
     {
       Topography::Step s = step(curr_hex,hex::A+dir);
-      if(s.to_hex && 0==visited.count(s.to_hex))
-          queue.insert( curr_route.step(s.to_hex,s.cost,goal) );
+      if(s.to_hex)
+          context.push(s.to_hex,curr.node,curr.cost+s.cost);
     }
   }
   throw no_solution("best_path");
 }
 
 
+hex::Path
+Topography::best_path_bidirectional(hex::Hex* start, hex::Hex* goal) const
+  throw(no_solution)
+{
+  SearchContext forward;
+  SearchContext backward;
+  return best_path_bidirectional(start,goal,forward,backward);
+}
+
+
+hex::Path
+Topography::best_path_bidirectional(
+    hex::Hex*       start,
+    hex::Hex*       goal,
+    SearchContext&  forward,
+    SearchContext&  backward
+  ) const throw(no_solution)
+{
+  if(start==goal)
+      return hex::Path(std::list<hex::Hex*>(1,start));
+  if(!is_reachable(start,goal))
+      throw no_solution("best_path_bidirectional");
+  // A lower bound on the cost of each step keeps the heuristic admissible.
+  const Cost min_step =
+    ( _min_cost>0 && _min_cost<std::numeric_limits<Cost>::max() )? _min_cost: 0;
+  forward.start(start->grid(),goal,start,min_step);
+  backward.start(goal->grid(),start,goal,min_step);
+  forward.push(start,forward.index(start),0);
+  backward.push(goal,backward.index(goal),0);
+  bool   found =false;
+  Cost   best  =0;  // Cost of the cheapest route found so far.
+  size_t meet_f =0; // That route steps from meet_f...
+  size_t meet_b =0; // ...to meet_b.
+  Cost top_f, top_b;
+  while(forward.peek(top_f) && backward.peek(top_b))
+  {
+    // The two heuristics cancel out along any route, so no route through
+    // the open nodes can be cheaper than top_f + top_b.
+    if(found && top_f + top_b >= best)
+        break;
+    SearchContext::Entry curr;
+    if(top_f <= top_b)
+    {
+      forward.pop(curr);
+      hex::Hex* curr_hex = forward.hex(curr.node);
+      for(int dir=0; dir<DIRECTIONS; ++dir)
+      {
+        Topography::Step s = step(curr_hex,hex::A+dir);
+        if(!s.to_hex)
+            continue;
+        forward.push(s.to_hex,curr.node,curr.cost+s.cost);
+        const size_t n =backward.index(s.to_hex);
+        if(backward.has_cost(n) &&
+           (!found || curr.cost + s.cost + backward.cost(n) < best))
+        {
+          found = true;
+          best = curr.cost + s.cost + backward.cost(n);
+          meet_f = curr.node;
+          meet_b = n;
+        }
+      }
+    }
+    else
+    {
+      backward.pop(curr);
+      hex::Hex* curr_hex = backward.hex(curr.node);
+      for(int dir=0; dir<DIRECTIONS; ++dir)
+      {
+        // Search backwards: pay the cost of stepping from prev to curr_hex.
+        hex::Hex* prev = curr_hex->go(hex::A+dir);
+        if(!prev)
+            continue;
+        Topography::Step s = step(prev,hex::A+dir+3);
+        if(!s.to_hex)
+            continue;
+        backward.push(prev,curr.node,curr.cost+s.cost);
+        const size_t n =forward.index(prev);
+        if(forward.has_cost(n) &&
+           (!found || forward.cost(n) + s.cost + curr.cost < best))
+        {
+          found = true;
+          best = forward.cost(n) + s.cost + curr.cost;
+          meet_f = n;
+          meet_b = curr.node;
+        }
+      }
+    }
+  }
+  if(!found)
+      throw no_solution("best_path_bidirectional");
+  std::list<hex::Hex*> result =forward.path(meet_f);
+  const std::list<hex::Hex*> rest =backward.path(meet_b); // goal...meet_b
+  result.insert(result.end(),rest.rbegin(),rest.rend());
+  return hex::Path(result);
+}
+
+
 hex::Area
 Topography::horizon(hex::Hex* start, Cost budget) const throw(no_solution)
+{
+  SearchContext context;
+  return horizon(start,budget,context);
+}
+
+
+hex::Area
+Topography::horizon(
+    hex::Hex*       start,
+    Cost            budget,
+    SearchContext&  context
+  ) const throw(no_solution)
 {
   std::set<hex::Hex*> visited;
-  std::multiset<_Route> queue;
-  queue.insert( _Route::factory(start) );
-  while(!queue.empty())
+  context.start(start->grid(),NULL);
+  context.push(start,context.index(start),0);
+  SearchContext::Entry curr;
+  while(context.pop(curr))
   {
-    _Route curr_route = *queue.begin();
-    queue.erase( queue.begin() );
-    hex::Hex* curr_hex = curr_route.path.back();
-    if(visited.count(curr_hex))
-        continue;
-    if(curr_route.cost > budget)
+    if(curr.cost > budget)
         continue;
+    hex::Hex* curr_hex = context.hex(curr.node);
     visited.insert(curr_hex);
     for(int dir=0; dir<DIRECTIONS; ++dir)
     {
       Topography::Step s = step(curr_hex,hex::A+dir);
-      if(s.to_hex && 0==visited.count(s.to_hex))
-          queue.insert( curr_route.step(s.to_hex,s.cost) );
+      if(s.to_hex)
+          context.push(s.to_hex,curr.node,curr.cost+s.cost);
     }
   }
-  return visited;
+  return hex::Area(visited,hex::Area::TRUSTED); // Reached one step at a time.
 }
 
 
@@ -222,6 +504,20 @@ Topography::step(hex::Hex* from_hex, Direction direction) const
   result.to_hex = from_hex->go(direction);
   if(!result.to_hex)
     return result;
+  if(_grid==&result.to_hex->grid())
+  {
+    const size_t n =
+      size_t(result.to_hex->i) + size_t(result.to_hex->j) * _grid->cols();
+    const int d =direction+3;
+    const unsigned char flags =_flags[n];
+    if(flags & (1<<d))
+        result.cost = _edge_cost[n * DIRECTIONS + d];
+    else if(flags & PASSABLE)
+        result.cost = _hex_cost[n];
+    else
+        result.to_hex = NULL;
+    return result;
+  }
   // If there's an edge cost, then use that.
   hex::Edge* to_edge = result.to_hex->edge(direction+3);
   std::map<hex::Edge*,Cost>::const_iterator epos = _edges.find(to_edge);
@@ -240,6 +536,197 @@ Topography::step(hex::Hex* from_hex, Direction direction) const
 }
 
 
+//
+// SEARCH CONTEXT
+
+SearchContext::SearchContext(void)
+  : _grid(NULL), _cols(0), _goal(NULL), _origin(NULL), _min_step(0),
+    _generation(1), _last_generation(Stamp(~0)/2 - 1), _seq(0),
+    _dense(false), _bits(0), _used(0), _slots(), _heap()
+  {}
+
+
+SearchContext::SearchContext(const hex::Grid& grid)
+  : _grid(NULL), _cols(0), _goal(NULL), _origin(NULL), _min_step(0),
+    _generation(1), _last_generation(Stamp(~0)/2 - 1), _seq(0),
+    _dense(true), _bits(0), _used(0), _slots(), _heap()
+{
+  start(grid,NULL);
+}
+
+
+void
+SearchContext::start(
+    const hex::Grid&  grid,
+    hex::Hex*         goal,
+    hex::Hex*         origin,
+    Cost              min_step
+  )
+{
+  if(_dense)
+  {
+    const size_t size =size_t(grid.cols()) * size_t(grid.rows());
+    if(size > _slots.size())
+    {
+      const Slot unseen = {0,0,0,0};
+      _slots.resize(size,unseen);
+    }
+  }
+  _grid = &grid;
+  _cols = grid.cols();
+  _goal = goal;
+  _origin = origin;
+  _min_step = min_step;
+  _seq = 0;
+  _used = 0;
+  _heap.clear(); // Keeps its capacity.
+  // Stamps from earlier searches are all less than 2*_generation.
+  ++_generation;
+  if(_generation > _last_generation)
+  {
+    for(std::vector<Slot>::iterator s =_slots.begin(); s!=_slots.end(); ++s)
+        s->stamp = 0;
+    _generation = 1;
+  }
+}
+
+
+const SearchContext::Slot*
+SearchContext::find(size_t n) const
+{
+  if(_dense)
+      return( _slots[n].stamp>=open_stamp()? &_slots[n]: NULL );
+  if(_slots.empty())
+      return NULL;
+  // Slots with old stamps are empty, so end the probe.
+  const size_t mask =_slots.size() - 1;
+  for(size_t k =bucket(n); _slots[k].stamp>=open_stamp(); k = (k+1) & mask)
+      if(_slots[k].node==n)
+          return &_slots[k];
+  return NULL;
+}
+
+
+SearchContext::Slot&
+SearchContext::demand(size_t n)
+{
+  if(_dense)
+      return _slots[n];
+  const Slot* found =find(n);
+  if(found)
+      return const_cast<Slot&>(*found);
+  // Keep the table no more than half full, so that probes stay short.
+  if(2 * (_used + 1) > _slots.size())
+      grow();
+  const size_t mask =_slots.size() - 1;
+  size_t k =bucket(n);
+  while(_slots[k].stamp>=open_stamp())
+      k = (k+1) & mask;
+  ++_used;
+  _slots[k].node = n;
+  _slots[k].stamp = 0;
+  return _slots[k];
+}
+
+
+void
+SearchContext::grow(void)
+{
+  std::vector<Slot> old;
+  old.swap(_slots);
+  _bits = std::max(_bits + 1, 6);
+  const Slot unseen = {0,0,0,0};
+  _slots.resize(size_t(1) << _bits,unseen);
+  const size_t mask =_slots.size() - 1;
+  for(std::vector<Slot>::const_iterator s =old.begin(); s!=old.end(); ++s)
+      if(s->stamp>=open_stamp())
+      {
+        size_t k =bucket(s->node);
+        while(_slots[k].stamp>=open_stamp())
+            k = (k+1) & mask;
+        _slots[k] = *s;
+      }
+}
+
+
+void
+SearchContext::push(hex::Hex* h, size_t parent, Cost cost)
+{
+  const size_t n =index(h);
+  Slot& s =demand(n);
+  if(s.stamp==closed_stamp() || (s.stamp==open_stamp() && s.cost<=cost))
+  {
+    // Routes that are no cheaper than one already on offer could never be
+    // popped first, so are dropped.
+    return;
+  }
+  s.stamp = open_stamp();
+  s.cost = cost;
+  s.parent = parent; // The cheapest offer always wins.
+  // With an origin, use the average of the forward and backward heuristics,
+  // so that searches from both ends agree on which routes are shortest.
+  const Cost h_cost =( _origin
+      ? ( Cost(hex::distance(h,_goal)) - Cost(hex::distance(h,_origin)) )
+        * _min_step / 2
+      : heuristic(h,_goal) );
+  Entry e = { cost + h_cost, _seq++, n, parent, cost };
+  _heap.push_back(e);
+  std::push_heap(_heap.begin(),_heap.end(),Later(_origin!=NULL));
+}
+
+
+bool
+SearchContext::peek(Cost& value)
+{
+  while(!_heap.empty())
+  {
+    if(!is_closed(_heap.front().node))
+    {
+      value = _heap.front().value;
+      return true;
+    }
+    std::pop_heap(_heap.begin(),_heap.end(),Later(_origin!=NULL));
+    _heap.pop_back();
+  }
+  return false;
+}
+
+
+bool
+SearchContext::pop(Entry& e)
+{
+  while(!_heap.empty())
+  {
+    std::pop_heap(_heap.begin(),_heap.end(),Later(_origin!=NULL));
+    e = _heap.back();
+    _heap.pop_back();
+    Slot& s =demand(e.node); // Every node on the heap has a slot.
+    if(s.stamp==closed_stamp())
+        continue;
+    s.stamp = closed_stamp();
+    s.cost = e.cost;
+    s.parent = e.parent;
+    return true;
+  }
+  return false;
+}
+
+
+std::list<hex::Hex*>
+SearchContext::path(size_t n) const
+{
+  std::list<hex::Hex*> result;
+  while(true)
+  {
+    result.push_front( hex(n) );
+    const size_t parent =find(n)->parent;
+    if(parent==n)
+        return result;
+    n = parent;
+  }
+}
+
+
 //
 // ROUTE
 
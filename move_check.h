@@ -0,0 +1,102 @@
+// Shared helpers for the behaviour tests of the routing engine: a Topography
+// that lets tests take single steps, and random topographies to search.
+
+#ifndef LIBHEX_MOVE_CHECK_H
+#define LIBHEX_MOVE_CHECK_H
+
+#include "check.h"
+#include "hexmove.h"
+
+#include <functional>
+#include <list>
+#include <map>
+#include <queue>
+#include <vector>
+
+namespace check {
+
+/** A Topography that lets the tests take single steps, and find least costs
+ *  with Dijkstra's algorithm. */
+class Probe: public hex::move::Topography
+{
+public:
+  Probe(void) {}
+  Probe(hex::move::Cost default_hex_cost)
+    : hex::move::Topography(default_hex_cost) {}
+  using hex::move::Topography::Step;
+
+  Step take(hex::Hex* h, hex::Direction d) const { return step(h,d); }
+  bool can_step(hex::Hex* h, hex::Direction d) const
+    { return step(h,d).to_hex!=NULL; }
+
+  /** The cost of walking along path p, or -1 if a step is not allowed. */
+  hex::move::Cost cost(const hex::Path& p) const
+    {
+      hex::move::Cost result =0;
+      const std::list<hex::Hex*>& hexes =p.hexes();
+      std::list<hex::Hex*>::const_iterator prev =hexes.begin();
+      for(std::list<hex::Hex*>::const_iterator h =prev; ++h!=hexes.end(); prev=h)
+      {
+        int d =0;
+        while(d<hex::DIRECTIONS && (*prev)->go(hex::A+d)!=*h)
+            ++d;
+        if(d==hex::DIRECTIONS || !step(*prev,hex::A+d).to_hex)
+            return -1;
+        result += step(*prev,hex::A+d).cost;
+      }
+      return result;
+    }
+
+  /** The least cost of any route from a to b, or -1 if there is none. */
+  hex::move::Cost least_cost(hex::Hex* a, hex::Hex* b) const
+    {
+      typedef std::pair<hex::move::Cost,hex::Hex*> Offer;
+      std::priority_queue< Offer,std::vector<Offer>,std::greater<Offer> > open;
+      std::map<hex::Hex*,hex::move::Cost> done;
+      open.push(Offer(0,a));
+      while(!open.empty())
+      {
+        const Offer o =open.top();
+        open.pop();
+        if(!done.insert(std::make_pair(o.second,o.first)).second)
+            continue;
+        if(o.second==b)
+            return o.first;
+        for(int d=0; d<hex::DIRECTIONS; ++d)
+        {
+          Step s =step(o.second,hex::A+d);
+          if(s.to_hex && !done.count(s.to_hex))
+              open.push(Offer(o.first + s.cost,s.to_hex));
+        }
+      }
+      return -1;
+    }
+};
+
+/** Any hex of g, at random. */
+inline hex::Hex* any_hex(const hex::Grid& g)
+{
+  return g.hex(random(g.cols()),random(g.rows()));
+}
+
+/** Random costs in quarters, so that sums are exact, some below 1 and some
+ *  zero. Edge costs either add to a hex's cost, or override it, which makes
+ *  some moves cheaper (or possible) in one direction only. */
+inline void scatter(const hex::Grid& g, hex::move::Topography& t)
+{
+  const int area =g.cols() * g.rows();
+  for(int k=0; k<area/2; ++k)
+      t.override_hex_cost(any_hex(g),0.25 * random(12));
+  for(int k=0; k<area/8; ++k)
+      t.increase_hex_cost(any_hex(g),random(3));
+  for(int k=0; k<area/6; ++k)
+      t.increase_edge_cost(any_hex(g)->edge(hex::A+random(hex::DIRECTIONS)),
+                           0.25 * random(16));
+  for(int k=0; k<area/6; ++k)
+      t.override_edge_cost(any_hex(g)->edge(hex::A+random(hex::DIRECTIONS)),
+                           0.25 * random(8));
+}
+
+} // end namespace check
+
+#endif // LIBHEX_MOVE_CHECK_H
@@ -33,7 +33,7 @@ Path::to_area(void) const
 {
   std::set<Hex*> result;
   std::copy(_hexes.begin(), _hexes.end(), std::inserter(result,result.end()));
-  return result;
+  return Area(result);
 }
 
 
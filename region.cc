@@ -0,0 +1,289 @@
+/*                            Package   : libhex
+ * region.cc                  Created   : 2010/03/14
+ *                            Author    : Alex Tingle
+ *
+ *    Copyright (C) 2010, Alex Tingle.
+ *
+ *    This file is part of the libhex application.
+ *
+ *    libhex is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Lesser General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 2.1 of the License, or (at your option) any later version.
+ *
+ *    libhex is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *    Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with this library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "hex.h"
+#include "internal.h"
+
+#include <deque>
+
+namespace hex {
+
+
+namespace {
+
+/** Helper: The neighbours of h, and which of them are members of s.
+ *  Returns the number of members. */
+inline int
+neighbours(const HexSet& s, const Hex* h, Hex* hd[DIRECTIONS], bool m[DIRECTIONS])
+{
+  int k =0;
+  for(int d=0; d<DIRECTIONS; ++d)
+  {
+    hd[d] = h->go(A+d);
+    m[d]  =( hd[d] && s.contains(hd[d]) );
+    if(m[d])
+        ++k;
+  }
+  return k;
+}
+
+
+/** Helper: The change in the Euler characteristic (vertices - edges + faces)
+ *  when a hex is added next to members m. Hexes only ever meet along whole
+ *  edges, so the corner between edges d & d+1 is new unless neighbour d or
+ *  d+1 is a member. */
+inline long
+euler_delta(const bool m[DIRECTIONS])
+{
+  long result =1; // One new face.
+  for(int d=0; d<DIRECTIONS; ++d)
+  {
+    if(m[d])
+        ++result; // An edge that is already there.
+    if(m[d] || m[(d+1)%DIRECTIONS])
+        --result; // A corner that is already there.
+  }
+  return result;
+}
+
+} // end anonymous namespace
+
+
+unsigned long long
+Region::key(const Hex* h) const
+{
+  return (unsigned long long)(h->i) +
+         (unsigned long long)(h->j) * (unsigned long long)(grid()->cols());
+}
+
+
+void
+Region::relabel(void)
+{
+  // Start a fresh forest with one flat tree per component.
+  const std::vector<Area::Span> spans =_hexes.spans();
+  std::vector<size_t> labels;
+  _components = label(spans,labels);
+  std::vector<size_t> first(_components,size_t(-1)); // Root of each tree.
+  // Swap in fresh containers, so that the memory held by old nodes is freed.
+  Nodes().swap(_node);
+  std::vector<size_t>().swap(_parent);
+  _node.rehash( size() );
+  _parent.reserve( size() );
+  const unsigned long long cols =grid()? grid()->cols(): 0;
+  for(size_t n=0; n<spans.size(); ++n)
+    for(int i=spans[n].i0; i<=spans[n].i1; ++i)
+    {
+      const size_t id =_parent.size();
+      if(first[labels[n]]==size_t(-1))
+          first[labels[n]] = id;
+      _node[ (unsigned long long)(i) + (unsigned long long)(spans[n].j)*cols ]
+        = id;
+      _parent.push_back( first[labels[n]] );
+    }
+}
+
+
+std::set<Edge*>
+Region::edges(void) const
+{
+  std::set<Edge*> result;
+  for(HexSet::const_iterator h=_hexes.begin(); h!=_hexes.end(); ++h)
+    for(int d=0; d<DIRECTIONS; ++d)
+    {
+      Hex* hd =(**h).go(A+d);
+      if(!hd || !_hexes.contains(hd))
+          result.insert( (**h).edge(A+d) );
+    }
+  return result;
+}
+
+
+Area
+Region::to_area(void) const
+{
+  if(empty())
+      return Area();
+  return Area(*grid(),_hexes.spans());
+}
+
+
+bool
+Region::add(Hex* h) throw(hex::invalid_argument)
+{
+  if(!_hexes.insert(h))
+      return false;
+  Hex* hd[DIRECTIONS];
+  bool m[DIRECTIONS];
+  const int k =neighbours(_hexes,h,hd,m);
+  _euler += euler_delta(m);
+  // h brings 6-k edges that face out, and covers k that faced it.
+  _perimeter += DIRECTIONS - 2*k;
+  // A fresh node, even if h was once a member before. Old nodes may still
+  // be in use, as links between the remaining members.
+  const size_t n =_parent.size();
+  _parent.push_back(n);
+  _node[key(h)] = n;
+  ++_components;
+  for(int d=0; d<DIRECTIONS; ++d)
+    if(m[d])
+    {
+      const size_t r  =find_root(_parent,n);
+      const size_t rd =find_root(_parent,_node[key(hd[d])]);
+      if(r!=rd)
+      {
+        _parent[r] = rd;
+        --_components;
+      }
+    }
+  if(_parent.size() > 2*size() + 64)
+      relabel(); // Throw away old nodes.
+  return true;
+}
+
+
+bool
+Region::remove(Hex* h)
+{
+  if(!_hexes.erase(h))
+      return false;
+  Hex* hd[DIRECTIONS];
+  bool m[DIRECTIONS];
+  const int k =neighbours(_hexes,h,hd,m);
+  _euler -= euler_delta(m);
+  _perimeter -= DIRECTIONS - 2*k;
+  // h's node stays in the forest, since other nodes may link through it.
+  _node.erase(key(h));
+  // If the member neighbours form a single run round h, then they are
+  // still joined to each other, so the number of components is the same.
+  Hex* seeds[DIRECTIONS/2]; // One member from each run.
+  int runs =0;
+  for(int d=0; d<DIRECTIONS; ++d)
+    if(m[d] && !m[(d+DIRECTIONS-1)%DIRECTIONS])
+        seeds[runs++] = hd[d];
+  if(k==0)
+      --_components;
+  else if(runs>1)
+      split(seeds,runs);
+  if(_parent.size() > 2*size() + 64)
+      relabel(); // Throw away old nodes.
+  return true;
+}
+
+
+void
+Region::split(Hex* const* seeds, int n)
+{
+  // Search out from every seed in turn, one hex at a time. Searches that
+  // meet join the same group. A group that runs out of hexes while another
+  // group is still going has found a part that is now cut off. No hex is
+  // reached twice, so this never costs more than relabel().
+  Nodes owner; // Search that reached each hex.
+  std::deque<Hex*> queue[DIRECTIONS/2];
+  std::vector<Hex*> found[DIRECTIONS/2];
+  int group[DIRECTIONS/2];
+  for(int s=0; s<n; ++s)
+  {
+    owner[key(seeds[s])] = s;
+    queue[s].push_back(seeds[s]);
+    found[s].push_back(seeds[s]);
+    group[s] = s;
+  }
+  int groups =n;
+  while(groups>1)
+  {
+    for(int s=0; s<n; ++s)
+    {
+      if(queue[s].empty())
+          continue;
+      Hex* h =queue[s].front();
+      queue[s].pop_front();
+      for(int d=0; d<DIRECTIONS; ++d)
+      {
+        Hex* hd =h->go(A+d);
+        if(!hd || !_hexes.contains(hd))
+            continue;
+        const std::pair<Nodes::iterator,bool> o =
+          owner.insert(std::make_pair(key(hd),size_t(s)));
+        if(o.second)
+        {
+          queue[s].push_back(hd);
+          found[s].push_back(hd);
+        }
+        else if(group[o.first->second]!=group[s])
+        {
+          const int old =group[o.first->second];
+          for(int t=0; t<n; ++t)
+            if(group[t]==old)
+                group[t] = group[s];
+          --groups;
+        }
+      }
+    }
+    for(int s=0; s<n && groups>1; ++s)
+    {
+      if(group[s]<0)
+          continue; // Already cut off.
+      bool done =true;
+      for(int t=0; t<n; ++t)
+        if(group[t]==group[s] && !queue[t].empty())
+            done = false;
+      if(!done)
+          continue;
+      // Give the part that is cut off a tree of its own.
+      const int g =group[s];
+      const size_t root =_parent.size();
+      for(int t=0; t<n; ++t)
+        if(group[t]==g)
+        {
+          for(size_t x=0; x<found[t].size(); ++x)
+          {
+            _node[key(found[t][x])] = _parent.size();
+            _parent.push_back(root);
+          }
+          group[t] = -1;
+        }
+      ++_components;
+      --groups;
+    }
+  }
+}
+
+
+Region::Region(void)
+  : _hexes(), _perimeter(0), _euler(0), _components(0),
+    _node(), _parent()
+{}
+
+
+Region::Region(const Area& a)
+  : _hexes(), _perimeter(0), _euler(0), _components(0),
+    _node(), _parent()
+{
+  const std::set<Hex*>& hexes =a.hexes();
+  for(std::set<Hex*>::const_iterator h=hexes.begin(); h!=hexes.end(); ++h)
+      add(*h);
+}
+
+
+} // end namespace hex
@@ -0,0 +1,188 @@
+/*                            Package   : libhex
+ * spiral.cc                  Created   : 2010/03/14
+ *                            Author    : Alex Tingle
+ *
+ *    Copyright (C) 2010, Alex Tingle.
+ *
+ *    This file is part of the libhex application.
+ *
+ *    libhex is free software; you can redistribute it and/or
+ *    modify it under the terms of the GNU Lesser General Public
+ *    License as published by the Free Software Foundation; either
+ *    version 2.1 of the License, or (at your option) any later version.
+ *
+ *    libhex is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *    Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with this library; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "hex.h"
+
+#include <algorithm>
+
+namespace hex {
+
+
+namespace {
+
+/** Helper: A radius that reaches every hex of grid g, from any hex of g.
+ *  Larger radii only add hexes that are off the grid. */
+inline size_t
+reach(const Grid& g)
+{
+  return size_t(g.cols()) + size_t(g.rows());
+}
+
+} // end anonymous namespace
+
+
+//
+// Spiral::const_iterator
+
+void
+Spiral::const_iterator::start(size_t radius)
+{
+  _radius = radius;
+  _side   = 0;
+  _count  = 0;
+  if(radius > _spiral->_r1)
+      return; // end()
+  _i = _spiral->_i;
+  _j = _spiral->_j;
+  if(radius>0)
+  {
+    // Walk each ring like range(): start r steps out in direction A, and
+    // then go round in directions C,D,E,F,A,B.
+    go(_i,_j,A,radius); // in/out: _i,_j
+    go(_i,_j,C);
+    _count = 1;
+  }
+}
+
+
+void
+Spiral::const_iterator::next(void)
+{
+  if(_radius==0)
+  {
+    start(1);
+  }
+  else if(_count<_radius)
+  {
+    ++_count;
+    go(_i,_j,C+_side);
+  }
+  else if(_side<DIRECTIONS-1)
+  {
+    ++_side;
+    _count = 1;
+    go(_i,_j,C+_side);
+  }
+  else
+  {
+    start(_radius+1);
+  }
+}
+
+
+void
+Spiral::const_iterator::seek(void)
+{
+  while(_radius<=_spiral->_r1 && !_spiral->_grid->is_in_range(_i,_j))
+      next();
+}
+
+
+Hex*
+Spiral::const_iterator::operator*(void) const
+{
+  return _spiral->_grid->hex(_i,_j);
+}
+
+
+Spiral::const_iterator::const_iterator(const Spiral* s, size_t radius)
+  : _spiral(s), _radius(0), _side(0), _count(0), _i(0), _j(0)
+{
+  start(radius);
+  seek();
+}
+
+
+//
+// Spiral
+
+Spiral::Spiral(const Hex* centre, size_t r0, size_t r1)
+  : _grid(&centre->grid()),
+    _i(centre->i),
+    _j(centre->j),
+    _r0(0),
+    _r1(std::min( r1, reach(*_grid) ))
+{
+  // If r0>r1, then begin() starts at end().
+  _r0 = std::min( r0, _r1+1 );
+}
+
+
+//
+// Disc::const_iterator
+
+void
+Disc::const_iterator::row(int j)
+{
+  // In axial co-ordinates, row r spans q in [max(-d,-d-dr), min(d,d-dr)]
+  // relative to the centre.
+  const Disc& d =*_disc;
+  const int q0 =axial_q(d._i,d._j);
+  for(_j=j; _j<=d._j1; ++_j)
+  {
+    const int dr =_j - d._j;
+    _i  = std::max(0, offset_i(q0+std::max(-d._r,-d._r-dr),_j));
+    _i1 = std::min(d._grid->cols()-1, offset_i(q0+std::min(d._r,d._r-dr),_j));
+    if(_i<=_i1)
+        return;
+  }
+  _i  = 0; // end()
+  _i1 = -1;
+  _j  = d._j1+1; // Even if j was further on.
+}
+
+
+Hex*
+Disc::const_iterator::operator*(void) const
+{
+  return _disc->_grid->hex(_i,_j);
+}
+
+
+Disc::const_iterator::const_iterator(const Disc* d, int j)
+  : _disc(d), _i(0), _j(0), _i1(0)
+{
+  row(j);
+}
+
+
+//
+// Disc
+
+Disc::Disc(const Hex* centre, int r)
+  : _grid(&centre->grid()),
+    _i(centre->i),
+    _j(centre->j),
+    _r(r<0? -1: int(std::min( size_t(r), reach(*_grid) ))),
+    _j0(0),
+    _j1(-1)
+{
+  if(_r>=0)
+  {
+    _j0 = int(std::max( 0L,                 long(_j) - _r ));
+    _j1 = int(std::min( long(_grid->rows()-1), long(_j) + _r ));
+  }
+}
+
+
+} // end namespace hex
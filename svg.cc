@@ -243,16 +243,16 @@ Document::draw_simple_area(const Area& a, float bias) const
 std::string
 Document::draw_complex_area(const Area& a, float bias) const
 {
-  using namespace std;
   std::ostringstream os;
   os<<"<path fill-rule=\"nonzero\""<<a.attributes()<<" d=\"";
-  const std::list<Point> apoints =a.boundary().stroke(bias);
+  const std::list<Boundary> contours =a.contours();
+  std::list<Boundary>::const_iterator c =contours.begin();
+  const std::list<Point> apoints =c->stroke(bias);
   output_path_data(*this,os,apoints.begin(),apoints.end());
-  std::list<Area> voids =a.enclosed_areas();
-  for(list<Area>::const_iterator v=voids.begin(); v!=voids.end(); ++v)
+  for(++c; c!=contours.end(); ++c)
   {
     os<<" ";
-    const std::list<Point> vpoints =v->boundary().stroke(-bias);
+    const std::list<Point> vpoints =c->stroke(-bias);
     output_path_data(*this,os,vpoints.rbegin(),vpoints.rend());
   }
   os<<"\"/>\n";
@@ -0,0 +1,97 @@
+// Behaviour tests for Topography::best_path_bidirectional(): on random
+// topographies, with one-way edge costs, costs below 1 (and zero), and no
+// default cost, every route must be a real route that costs exactly as
+// little as Dijkstra's algorithm says it can.
+
+#include "move_check.h"
+
+using namespace hex;
+using check::Probe;
+
+
+/** Checks one search from a to b against Dijkstra's algorithm. */
+void check_route(
+    const Probe&           t,
+    Hex*                   a,
+    Hex*                   b,
+    move::SearchContext&   forward,
+    move::SearchContext&   backward
+  )
+{
+  const move::Cost least =t.least_cost(a,b);
+  if(least<0)
+  {
+    CHECK_THROWS(t.best_path_bidirectional(a,b),move::no_solution);
+    CHECK_THROWS(t.best_path_bidirectional(a,b,forward,backward),
+                 move::no_solution);
+    return;
+  }
+  const Path p =t.best_path_bidirectional(a,b);
+  CHECK(p.hexes().front()==a && p.hexes().back()==b);
+  CHECK(t.cost(p)==least);
+  const Path q =t.best_path_bidirectional(a,b,forward,backward);
+  CHECK(q.hexes().front()==a && q.hexes().back()==b);
+  CHECK(t.cost(q)==least);
+}
+
+
+void test_dijkstra(void)
+{
+  move::SearchContext forward;
+  move::SearchContext backward;
+  for(int t=0; t<400; ++t)
+  {
+    Grid g(3+check::random(30),3+check::random(30));
+    Probe topo;
+    switch(t%4)
+    {
+      case 0: break; // No default: only listed hexes can be entered.
+      case 1: topo = Probe(1.0);  break;
+      case 2: topo = Probe(0.25); break; // Steps cheaper than their length.
+      case 3: topo = Probe(3.0);  break;
+    }
+    check::scatter(g,topo);
+    if(t%3==0)
+        topo.compile(g);
+    else if(t%3==1)
+        topo.index_reachability(g);
+    for(int k=0; k<5; ++k)
+    {
+      Hex* a =check::any_hex(g);
+      check_route(topo,a,check::any_hex(g),forward,backward);
+      // Next door, and in the same place.
+      Hex* next =a->go(A+check::random(DIRECTIONS));
+      if(next)
+      {
+        check_route(topo,a,next,forward,backward);
+        check_route(topo,next,a,forward,backward);
+      }
+      check_route(topo,a,a,forward,backward);
+    }
+  }
+}
+
+
+/** A one-way short cut: cheap from a to b, dear from b to a. */
+void test_one_way(void)
+{
+  Grid g(20,20);
+  Probe t(1.0);
+  Hex* a =g.hex(5,5);
+  Hex* b =a->go(A);
+  t.override_hex_cost(b,10);
+  t.override_edge_cost(b->edge(D),0.5); // Entering b from a.
+  t.override_hex_cost(a,10);
+  CHECK(t.cost(t.best_path_bidirectional(a,b))==0.5);
+  CHECK(t.best_path_bidirectional(a,b).hexes().size()==2);
+  CHECK(t.cost(t.best_path_bidirectional(b,a))==t.least_cost(b,a));
+  CHECK(t.least_cost(b,a)==10);
+}
+
+
+int main(void)
+{
+  test_dijkstra();
+  test_one_way();
+  return check::report("test_bidirectional");
+}
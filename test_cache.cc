@@ -0,0 +1,145 @@
+// Behaviour tests for Area's cache of derived geometry: copies share it,
+// and concurrent readers all see the same results.
+
+#include "check.h"
+#include "hex.h"
+
+#include <list>
+#include <pthread.h>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace hex;
+
+
+/** Everything an Area calculates and remembers, as one value. */
+struct Geometry
+{
+  std::set<Hex*>         hexes;
+  std::list<Edge*>       boundary;
+  size_t                 holes;
+  size_t                 contours;
+  int                    i0,j0,i1,j1;
+  std::string            str;
+  size_t                 fillpaths;
+
+  explicit Geometry(const Area& a)
+    : hexes(a.hexes()), boundary(a.boundary().edges()),
+      holes(a.enclosed_areas().size()), contours(a.contours().size()),
+      i0(0), j0(0), i1(0), j1(0), str(a.str(*a.hexes().begin())),
+      fillpaths(a.fillpaths().size())
+    { a.bounding_box(i0,j0,i1,j1); }
+
+  bool operator==(const Geometry& v) const
+    {
+      return( hexes==v.hexes && boundary==v.boundary && holes==v.holes &&
+              contours==v.contours && i0==v.i0 && j0==v.j0 && i1==v.i1 &&
+              j1==v.j1 && str==v.str && fillpaths==v.fillpaths );
+    }
+};
+
+
+/** A disc with a few holes in it. */
+Area holed(const Grid& g, Area::Storage storage)
+{
+  std::set<Hex*> hexes =Area(g.hex(20,20),12).hexes();
+  hexes.erase( g.hex(20,20) );
+  hexes.erase( g.hex(15,18) );
+  hexes.erase( g.hex(24,25) );
+  return Area( Area(hexes), storage );
+}
+
+
+struct Job
+{
+  const Area*  area;
+  bool         copy; ///< TRUE: work on a private copy of area.
+  Geometry*    result;
+};
+
+
+void* run(void* arg)
+{
+  Job& job =*static_cast<Job*>(arg);
+  if(job.copy)
+  {
+    const Area a(*job.area);
+    job.result = new Geometry(a);
+  }
+  else
+  {
+    job.result = new Geometry(*job.area);
+  }
+  return NULL;
+}
+
+
+void test_threads(const Grid& g, Area::Storage storage)
+{
+  const Geometry expected( holed(g,storage) );
+  CHECK( expected.holes==3 && expected.contours==4 );
+  for(int trial=0; trial<20; ++trial)
+  {
+    // Fresh area each time, so that the threads race to fill its cache.
+    const Area area =holed(g,storage);
+    const int n =8;
+    std::vector<Job> jobs(n);
+    std::vector<pthread_t> threads(n);
+    for(int k=0; k<n; ++k)
+    {
+      jobs[k].area = &area;
+      jobs[k].copy = (k&1);
+      jobs[k].result = NULL;
+      CHECK( 0==pthread_create(&threads[k],NULL,run,&jobs[k]) );
+    }
+    for(int k=0; k<n; ++k)
+    {
+      pthread_join(threads[k],NULL);
+      CHECK( jobs[k].result && *jobs[k].result==expected );
+      delete jobs[k].result;
+    }
+    CHECK( Geometry(area)==expected );
+  }
+}
+
+
+void test_copies(const Grid& g)
+{
+  // Copies, assignments & storage conversions keep working after the
+  // original has gone.
+  Area* original =new Area( holed(g,Area::SPANS) );
+  const Geometry expected(*original);
+  Area copy(*original);
+  Area assigned;
+  assigned = *original;
+  const Area converted(*original,Area::HEXES);
+  delete original;
+  CHECK( Geometry(copy)==expected );
+  CHECK( Geometry(assigned)==expected );
+  CHECK( Geometry(converted)==expected );
+  assigned = assigned;
+  CHECK( Geometry(assigned)==expected );
+  assigned = Area(g.hex(1,1));
+  CHECK( assigned.size()==1 && assigned.enclosed_areas().empty() );
+  CHECK( Geometry(copy)==expected );
+
+  // Fill paths from a different origin are still calculated correctly.
+  const Area a =holed(g,Area::HEXES);
+  const std::list<Path> first =a.fillpaths(g.hex(20,10));
+  const std::list<Path> second =a.fillpaths(g.hex(21,30));
+  CHECK( first.front().hexes().front()==g.hex(20,10) );
+  CHECK( second.front().hexes().front()==g.hex(21,30) );
+  CHECK( a.fillpaths(g.hex(20,10)).size()==first.size() );
+  CHECK( g.area(a.str(g.hex(21,30))).hexes()==a.hexes() );
+}
+
+
+int main()
+{
+  Grid g(40,40);
+  test_threads(g,Area::HEXES);
+  test_threads(g,Area::SPANS);
+  test_copies(g);
+  return check::report("test_cache");
+}
@@ -0,0 +1,113 @@
+// Behaviour tests for Topography::compile(): every step must cost the same
+// from the flat arrays as from the maps, so best_path and horizon find the
+// same routes, with or without compile() or index_reachability(). Changing
+// a cost must throw the arrays away.
+
+#include "move_check.h"
+
+using namespace hex;
+using check::Probe;
+
+
+/** Each step from every hex of g agrees between a and b. */
+bool same_steps(const Grid& g, const Probe& a, const Probe& b)
+{
+  for(int j=0; j<g.rows(); ++j)
+    for(int i=0; i<g.cols(); ++i)
+      for(int d=0; d<DIRECTIONS; ++d)
+      {
+        const Probe::Step sa =a.take(g.hex(i,j),A+d);
+        const Probe::Step sb =b.take(g.hex(i,j),A+d);
+        if(sa.to_hex!=sb.to_hex || (sa.to_hex && sa.cost!=sb.cost))
+            return false;
+      }
+  return true;
+}
+
+
+/** The same path (or none) and the same horizon from maps and arrays. */
+void same_routes(const Grid& g, const Probe& maps, const Probe& flat)
+{
+  for(int k=0; k<10; ++k)
+  {
+    Hex* a =check::any_hex(g);
+    Hex* b =check::any_hex(g);
+    bool found =true;
+    Path p;
+    try
+    {
+      p = maps.best_path(a,b);
+    }
+    catch(move::no_solution&)
+    {
+      found = false;
+    }
+    if(!found)
+    {
+      CHECK_THROWS(flat.best_path(a,b),move::no_solution);
+      continue;
+    }
+    const Path q =flat.best_path(a,b);
+    CHECK(q.str()==p.str());
+    CHECK(maps.cost(p)>=0 && flat.cost(q)==maps.cost(p));
+    const move::Cost budget =check::random(6);
+    CHECK(flat.horizon(a,budget).hexes()==maps.horizon(a,budget).hexes());
+  }
+}
+
+
+void test_compile(void)
+{
+  for(int t=0; t<100; ++t)
+  {
+    Grid g(3+check::random(30),3+check::random(30));
+    Probe maps =( t%3==0? Probe(): Probe(t%2? 1.0: 0.5) );
+    check::scatter(g,maps);
+    CHECK(!maps.is_compiled());
+
+    Probe flat =maps;
+    flat.compile(g);
+    CHECK(flat.is_compiled());
+    CHECK(same_steps(g,maps,flat));
+    same_routes(g,maps,flat);
+
+    Probe indexed =maps;
+    indexed.index_reachability(g);
+    CHECK(!indexed.is_compiled());
+    same_routes(g,maps,indexed);
+
+    // Arrays compiled for another grid are not used for g.
+    Grid other(g.cols(),g.rows());
+    Probe elsewhere =maps;
+    elsewhere.compile(other);
+    CHECK(same_steps(g,maps,elsewhere));
+
+    // Any change throws the arrays away, and the maps see it.
+    Hex* h =check::any_hex(g);
+    switch(t%4)
+    {
+      case 0: flat.override_hex_cost(h,3);     maps.override_hex_cost(h,3);
+              break;
+      case 1: flat.increase_hex_cost(h,2);     maps.increase_hex_cost(h,2);
+              break;
+      case 2: flat.override_edge_cost(h->edge(A),0.25);
+              maps.override_edge_cost(h->edge(A),0.25);
+              break;
+      case 3: flat.increase_edge_cost(h->edge(D),1);
+              maps.increase_edge_cost(h->edge(D),1);
+              break;
+    }
+    CHECK(!flat.is_compiled());
+    CHECK(same_steps(g,maps,flat));
+    flat.compile(g);
+    CHECK(same_steps(g,maps,flat));
+    same_routes(g,maps,flat);
+  }
+}
+
+
+int main(void)
+{
+  test_compile();
+  return check::report("test_compile");
+}
@@ -0,0 +1,132 @@
+// Behaviour tests for the scanline flood behind hex::fill and
+// Boundary::area, checked against a plain breadth-first search.
+
+#include "check.h"
+#include "hex.h"
+
+#include <deque>
+#include <set>
+
+using namespace hex;
+
+
+/** Reference flood: a breadth-first search from the hexes in seeds. */
+std::set<Hex*> reference(const std::set<Hex*>& beyond,
+                         const std::set<Hex*>& seeds)
+{
+  std::set<Hex*> result;
+  std::deque<Hex*> queue;
+  for(std::set<Hex*>::const_iterator h=seeds.begin(); h!=seeds.end(); ++h)
+  {
+    // Seeds are always in the result. Those in beyond only spread to their
+    // neighbours.
+    result.insert(*h);
+    if(!beyond.count(*h))
+        queue.push_back(*h);
+    else
+        for(int d=0; d<DIRECTIONS; ++d)
+        {
+          Hex* n =(**h).go(A+d);
+          if(n && !beyond.count(n) && result.insert(n).second)
+              queue.push_back(n);
+        }
+  }
+  while(!queue.empty())
+  {
+    Hex* h =queue.front();
+    queue.pop_front();
+    for(int d=0; d<DIRECTIONS; ++d)
+    {
+      Hex* n =h->go(A+d);
+      if(n && !beyond.count(n) && result.insert(n).second)
+          queue.push_back(n);
+    }
+  }
+  return result;
+}
+
+
+std::set<Hex*> random_hexes(const Grid& g, int n)
+{
+  std::set<Hex*> result;
+  for(int k=0; k<n; ++k)
+      result.insert( g.hex(check::random(g.cols()),check::random(g.rows())) );
+  return result;
+}
+
+
+void test_random(const Grid& g)
+{
+  for(int trial=0; trial<300; ++trial)
+  {
+    // Walls of varying density, so that some floods are blocked early and
+    // others leak all over the grid.
+    const int area =g.cols() * g.rows();
+    const std::set<Hex*> beyond =random_hexes(g, check::random(area*2/3));
+    const std::set<Hex*> seeds =random_hexes(g, 1+check::random(3));
+    const std::set<Hex*> expected =reference(beyond,seeds);
+    const Area a(seeds,Area::TRUSTED);
+
+    const Area by_set =fill(beyond,a);
+    const Area by_hexset =fill(HexSet(beyond),a);
+    CHECK( by_set.storage()==Area::SPANS );
+    CHECK( by_set.hexes()==expected );
+    CHECK( by_hexset.hexes()==expected );
+    if(seeds.size()==1)
+    {
+      Hex* h =*seeds.begin();
+      CHECK( fill(beyond,h).hexes()==expected );
+      CHECK( fill(HexSet(beyond),h).hexes()==expected );
+    }
+  }
+}
+
+
+void test_cases(const Grid& g)
+{
+  Hex* centre =g.hex(10,10);
+  const std::set<Hex*> none;
+
+  // With nothing in the way, the flood covers the whole grid.
+  CHECK( fill(none,centre).size()==size_t(g.cols()*g.rows()) );
+
+  // A ring fences in a disc.
+  const Spiral wall =ring(centre,3);
+  const std::set<Hex*> beyond(wall.begin(),wall.end());
+  const Area inside(centre,2);
+  CHECK( fill(beyond,centre).hexes()==inside.hexes() );
+  CHECK( fill(HexSet(beyond),centre).hexes()==inside.hexes() );
+
+  // A seed in the wall is kept, and spreads to both sides.
+  Hex* gate =*wall.begin();
+  const Area both =fill(beyond,gate);
+  CHECK( both.contains(gate) && both.contains(centre) );
+  CHECK( both.size()==size_t(g.cols()*g.rows()) - beyond.size() + 1 );
+
+  // Hexes from another grid are never in the way.
+  Grid other(g.cols(),g.rows());
+  std::set<Hex*> foreign;
+  foreign.insert( other.hex(11,10) );
+  CHECK( fill(foreign,centre).size()==size_t(g.cols()*g.rows()) );
+
+  // An empty area fills nothing.
+  CHECK( fill(beyond,Area()).size()==0 );
+
+  // Boundary::area() recovers the area inside a closed boundary, holes and
+  // all.
+  const Area disc(centre,4);
+  CHECK( disc.boundary().area().hexes()==disc.hexes() );
+  std::set<Hex*> holed =disc.hexes();
+  holed.erase(centre);
+  const Area ring_area(holed);
+  CHECK( ring_area.boundary().area().hexes()==disc.hexes() );
+}
+
+
+int main()
+{
+  Grid g(25,20);
+  test_random(g);
+  test_cases(g);
+  return check::report("test_fill");
+}
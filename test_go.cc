@@ -0,0 +1,152 @@
+// Behaviour tests for the closed-form moves: go(i,j,d,n), Hex::go(d,n) and
+// distance() must agree with taking one step at a time, by the odd & even
+// row rules, from random hexes on and off the grid, in every direction.
+
+#include "check.h"
+#include "hex.h"
+
+#include <deque>
+#include <map>
+#include <utility>
+
+using namespace hex;
+
+
+/** One step from i,j in direction d, the long way: the neighbours of a hex
+ *  depend on whether its row is odd or even. */
+void step(int& i, int& j, Direction d)
+{
+  if(j%2)
+      switch(d) // odd
+      {
+        case A: ++i;      break;
+        case B: ++i; ++j; break;
+        case C:      ++j; break;
+        case D: --i;      break;
+        case E:      --j; break;
+        case F: ++i; --j; break;
+      }
+  else
+      switch(d) // even
+      {
+        case A: ++i;      break;
+        case B:      ++j; break;
+        case C: --i; ++j; break;
+        case D: --i;      break;
+        case E: --i; --j; break;
+        case F:      --j; break;
+      }
+}
+
+
+/** The fewest steps from i0,j0 to i1,j1, by breadth-first search. */
+size_t search(int i0, int j0, int i1, int j1)
+{
+  typedef std::pair<int,int> Place;
+  std::map<Place,size_t> seen;
+  std::deque<Place> queue(1,Place(i0,j0));
+  seen[queue.front()] = 0;
+  while(true)
+  {
+    const Place p =queue.front();
+    queue.pop_front();
+    const size_t n =seen[p];
+    if(p==Place(i1,j1))
+        return n;
+    for(int d=0; d<DIRECTIONS; ++d)
+    {
+      Place next =p;
+      step(next.first,next.second,A+d);
+      if(seen.insert(std::make_pair(next,n+1)).second)
+          queue.push_back(next);
+    }
+  }
+}
+
+
+/** go(i,j,d,n) on co-ordinates, with no grid, including negative ones. */
+void test_coordinates(void)
+{
+  for(int k=0; k<20000; ++k)
+  {
+    const int i0 =check::random(200) - 100;
+    const int j0 =check::random(200) - 100;
+    const Direction d =A + check::random(DIRECTIONS);
+    const size_t n =check::random(60);
+    int i =i0;
+    int j =j0;
+    go(i,j,d,n);
+    int si =i0;
+    int sj =j0;
+    for(size_t s=0; s<n; ++s)
+        step(si,sj,d);
+    CHECK(i==si && j==sj);
+    CHECK(distance(i0,j0,i,j)==n);
+    // And back again.
+    go(i,j,d+3,n);
+    CHECK(i==i0 && j==j0);
+  }
+}
+
+
+/** Hex::go(d,n) on a grid: lands where n single steps land, or is NULL if
+ *  any of them falls off. Starts are biased towards the edges. */
+void test_hexes(const Grid& g)
+{
+  for(int k=0; k<20000; ++k)
+  {
+    const int edge =check::random(4);
+    int i =check::random(g.cols());
+    int j =check::random(g.rows());
+    if(edge==0) i = check::random(3);
+    if(edge==1) j = g.rows() - 1 - check::random(3);
+    Hex* h =g.hex(i,j);
+    const Direction d =A + check::random(DIRECTIONS);
+    const int n =check::random(k%2? 8: 40);
+    Hex* expected =h;
+    int si =i;
+    int sj =j;
+    for(int s=0; s<n; ++s)
+    {
+      step(si,sj,d);
+      if(expected)
+          expected = expected->go(d);
+    }
+    CHECK(h->go(d,n)==expected);
+    CHECK( expected? (expected->i==si && expected->j==sj)
+                   : !g.is_in_range(si,sj) );
+  }
+}
+
+
+/** distance() against breadth-first search, and against the length of the
+ *  path from steps(). */
+void test_distance(const Grid& g)
+{
+  for(int k=0; k<3000; ++k)
+  {
+    Hex* a =g.hex(check::random(g.cols()),check::random(g.rows()));
+    Hex* b =g.hex(check::random(g.cols()),check::random(g.rows()));
+    const size_t n =distance(a,b);
+    CHECK(n==distance(b,a));
+    CHECK(n==steps(a,b).size());
+    if(k<300)
+        CHECK(n==search(a->i,a->j,b->i,b->j));
+  }
+  // Near neighbours, including every parity of row and column.
+  for(int j=10; j<14; ++j)
+    for(int i=10; i<14; ++i)
+      for(int j1=j-3; j1<=j+3; ++j1)
+        for(int i1=i-3; i1<=i+3; ++i1)
+            CHECK(distance(i,j,i1,j1)==search(i,j,i1,j1));
+}
+
+
+int main(void)
+{
+  test_coordinates();
+  Grid g(37,24);
+  test_hexes(g);
+  test_distance(g);
+  return check::report("test_go");
+}
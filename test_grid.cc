@@ -0,0 +1,412 @@
+// Behaviour tests for Grid storage: DENSE and SPARSE grids of the same size
+// must agree on every hex, neighbour, edge and distance, and so must their
+// copies. Threads that race to make the same SPARSE tiles must all get the
+// same Hexes, and only one copy of each tile may be kept. A user's Allocator
+// must get back every block it gives out, at the size it gave. Grids as
+// big as an int allows must work right up to their far corners. Each Hex's
+// cache of its neighbours must agree with a fresh calculation, off the
+// edge of the grid and in copies too.
+
+#include "check.h"
+#include "hex.h"
+
+#include <climits>
+#include <map>
+#include <pthread.h>
+#include <vector>
+
+using namespace hex;
+
+
+/** An Allocator that keeps count of what it has handed out. Thread-safe. */
+class Counting: public Allocator
+{
+  pthread_mutex_t         _lock;
+  std::map<void*,size_t>  _live;
+public:
+  size_t  allocations;
+  size_t  deallocations;
+  size_t  allocated_bytes;
+  size_t  deallocated_bytes;
+  size_t  mismatches; ///< deallocate() calls that match no allocate().
+
+  Counting(void)
+    : _live(), allocations(0), deallocations(0), allocated_bytes(0),
+      deallocated_bytes(0), mismatches(0)
+    { pthread_mutex_init(&_lock,NULL); }
+  virtual ~Counting(void) { pthread_mutex_destroy(&_lock); }
+
+  virtual void* allocate(size_t bytes)
+    {
+      void* result =::operator new(bytes);
+      pthread_mutex_lock(&_lock);
+      ++allocations;
+      allocated_bytes += bytes;
+      _live[result] = bytes;
+      pthread_mutex_unlock(&_lock);
+      return result;
+    }
+  virtual void deallocate(void* p, size_t bytes)
+    {
+      pthread_mutex_lock(&_lock);
+      ++deallocations;
+      deallocated_bytes += bytes;
+      std::map<void*,size_t>::iterator pos =_live.find(p);
+      if(pos==_live.end() || pos->second!=bytes)
+          ++mismatches;
+      else
+          _live.erase(pos);
+      pthread_mutex_unlock(&_lock);
+      ::operator delete(p);
+    }
+
+  /** TRUE iff every block has been handed back, at the size it was given. */
+  bool balanced(void) const
+    {
+      return _live.empty() && mismatches==0 && allocations==deallocations &&
+             allocated_bytes==deallocated_bytes;
+    }
+  /** Blocks that have not been handed back. */
+  size_t live(void) const { return _live.size(); }
+  /** Bytes that have not been handed back. */
+  size_t live_bytes(void) const
+    {
+      size_t result =0;
+      for(std::map<void*,size_t>::const_iterator i=_live.begin(); i!=_live.end(); ++i)
+          result += i->second;
+      return result;
+    }
+};
+
+
+/** TRUE iff a & b are the same hex, by co-ordinates, or both NULL. */
+bool same(const Hex* a, const Hex* b)
+{
+  if(!a || !b)
+      return a==b;
+  return a->i==b->i && a->j==b->j;
+}
+
+
+/** Every query of dense agrees with the same query of sparse. */
+void check_same(const Grid& dense, const Grid& sparse)
+{
+  CHECK(dense.cols()==sparse.cols() && dense.rows()==sparse.rows());
+  CHECK(dense.storage()==Grid::DENSE && sparse.storage()==Grid::SPARSE);
+  for(int j=-2; j<dense.rows()+2; ++j)
+    for(int i=-2; i<dense.cols()+2; ++i)
+    {
+      const bool in =dense.is_in_range(i,j);
+      CHECK(in==sparse.is_in_range(i,j));
+      if(!in)
+      {
+        CHECK_THROWS(dense.hex(i,j),out_of_range);
+        CHECK_THROWS(sparse.hex(i,j),out_of_range);
+        continue;
+      }
+      Hex* d =dense.hex(i,j);
+      Hex* s =sparse.hex(i,j);
+      CHECK(d->i==i && d->j==j && same(d,s));
+      CHECK(&d->grid()==&dense && &s->grid()==&sparse);
+      CHECK(d==dense.hex(i,j) && s==sparse.hex(i,j));
+      for(int k=0; k<DIRECTIONS; ++k)
+      {
+        CHECK(same(d->go(A+k),s->go(A+k)));
+        CHECK(!d->go(A+k) || &d->go(A+k)->grid()==&dense);
+        CHECK(!s->go(A+k) || &s->go(A+k)->grid()==&sparse);
+        CHECK(same(d->go(A+k,3),s->go(A+k,3)));
+        CHECK(d->edge(A+k)->hex()==d && d->edge(A+k)->direction()==A+k);
+        CHECK(s->edge(A+k)->hex()==s && s->edge(A+k)->direction()==A+k);
+        const Edge* dc =d->edge(A+k)->complement();
+        const Edge* sc =s->edge(A+k)->complement();
+        CHECK(same(dc? dc->hex(): NULL, sc? sc->hex(): NULL));
+        CHECK(same(dc? dc->hex(): NULL, d->go(A+k)));
+      }
+      Hex* d2 =dense.hex(check::random(dense.cols()),check::random(dense.rows()));
+      Hex* s2 =sparse.hex(d2->i,d2->j);
+      CHECK(distance(d,d2)==distance(s,s2));
+      CHECK(steps(d,d2)==steps(s,s2));
+    }
+}
+
+
+void test_storage(void)
+{
+  const int sizes[][2] ={ {1,1}, {1,7}, {7,1}, {64,64}, {65,63}, {130,70} };
+  for(size_t n=0; n<sizeof(sizes)/sizeof(sizes[0]); ++n)
+  {
+    Grid dense(sizes[n][0],sizes[n][1],Grid::DENSE);
+    Grid sparse(sizes[n][0],sizes[n][1],Grid::SPARSE);
+    check_same(dense,sparse);
+    // Copies share nothing with the original, but hold the same hexes.
+    Grid dense_copy(dense);
+    Grid sparse_copy(sparse);
+    CHECK(dense_copy.hex(0,0)!=dense.hex(0,0));
+    CHECK(sparse_copy.hex(0,0)!=sparse.hex(0,0));
+    check_same(dense_copy,sparse_copy);
+    check_same(dense,sparse_copy);
+  }
+  // An empty grid has no hexes at all.
+  Grid empty(0,5,Grid::DENSE);
+  CHECK(!empty.is_in_range(0,0));
+  CHECK_THROWS(empty.hex(0,0),out_of_range);
+}
+
+
+void test_allocator(void)
+{
+  const size_t HEX =sizeof(Hex);
+  const size_t SECTOR =64*64*sizeof(Hex*);
+  {
+    // DENSE: one block for the whole grid, and another for each copy.
+    Counting counter;
+    {
+      Grid g(100,70,Grid::DENSE,&counter);
+      CHECK(counter.allocations==1 && counter.live_bytes()==100*70*HEX);
+      {
+        Grid copy(g);
+        CHECK(&copy.hex(5,5)->grid()==&copy);
+        CHECK(counter.allocations==2 && counter.live_bytes()==2*100*70*HEX);
+      }
+      CHECK(counter.live()==1 && counter.live_bytes()==100*70*HEX);
+    }
+    CHECK(counter.balanced());
+    // An empty DENSE grid takes nothing.
+    { Grid g(0,10,Grid::DENSE,&counter); }
+    CHECK(counter.balanced() && counter.allocations==2);
+  }
+  {
+    // SPARSE: nothing until a hex is used, then a sector and a tile.
+    Counting counter;
+    {
+      Grid g(100,70,Grid::SPARSE,&counter);
+      CHECK(counter.allocations==0);
+      g.hex(99,69); // A clipped 36x6 tile, at the corner.
+      CHECK(counter.live()==2 && counter.live_bytes()==SECTOR + 36*6*HEX);
+      {
+        Grid copy(g); // Makes its own tiles, as they are used.
+        CHECK(counter.live()==2);
+        for(int j=0; j<copy.rows(); ++j)
+          for(int i=0; i<copy.cols(); ++i)
+              copy.hex(i,j);
+        CHECK(counter.live()==2 + 1 + 2*2);
+        CHECK(counter.live_bytes()==2*SECTOR + (36*6 + 100*70)*HEX);
+      }
+      CHECK(counter.live()==2);
+    }
+    CHECK(counter.balanced());
+  }
+  {
+    // A bigger SPARSE grid has a tree of sectors: a root, and one sector
+    // below it for each corner that is used.
+    Counting counter;
+    {
+      Grid g(5000,5000,Grid::SPARSE,&counter);
+      g.hex(0,0);
+      g.hex(4999,4999); // A clipped 8x8 tile.
+      CHECK(counter.live()==1 + 2 + 2);
+      CHECK(counter.live_bytes()==3*SECTOR + (64*64 + 8*8)*HEX);
+      Grid copy(g);
+      copy.hex(4999,0);
+    }
+    CHECK(counter.balanced());
+  }
+}
+
+
+/** Checks every neighbour of every hex in g, twice: first while the cache
+ *  is filled, then from the cache. */
+void check_neighbours(const Grid& g)
+{
+  for(int pass=0; pass<2; ++pass)
+    for(int j=0; j<g.rows(); ++j)
+      for(int i=0; i<g.cols(); ++i)
+      {
+        Hex* h =g.hex(i,j);
+        for(int d=0; d<DIRECTIONS; ++d)
+        {
+          int ni =i;
+          int nj =j;
+          go(ni,nj,A+d);
+          Hex* expected =( g.is_in_range(ni,nj)? g.hex(ni,nj): NULL );
+          Hex* n =h->go(A+d);
+          CHECK(n==expected);
+          CHECK(n!=h); // The off-grid marker never escapes.
+          CHECK(!n || n->go(A+d+3)==h);
+        }
+      }
+}
+
+
+void test_neighbours(void)
+{
+  for(int storage=Grid::SPARSE; storage<=Grid::DENSE; ++storage)
+  {
+    Grid one(1,1,Grid::Storage(storage));
+    check_neighbours(one);
+    for(int d=0; d<DIRECTIONS; ++d)
+        CHECK(!one.hex(0,0)->go(A+d));
+
+    Grid g(70,67,Grid::Storage(storage));
+    check_neighbours(g);
+    // A copy of a grid whose caches are full starts with empty caches of
+    // its own: it never links back to the original's hexes.
+    Grid copy(g);
+    check_neighbours(copy);
+    check_neighbours(g);
+    {
+      Grid copy2(copy);
+      check_neighbours(copy2);
+    }
+    check_neighbours(copy);
+  }
+}
+
+
+void test_limits(void)
+{
+  // The biggest grid there can be.
+  Counting counter;
+  {
+    const Grid g(INT_MAX,INT_MAX,Grid::SPARSE,&counter);
+    const int far =INT_MAX - 1;
+    Hex* corner =g.hex(far,far);
+    Hex* origin =g.hex(0,0);
+    CHECK(corner->i==far && corner->j==far);
+    CHECK(g.is_in_range(far,far) && !g.is_in_range(INT_MAX,far));
+    CHECK_THROWS(g.hex(INT_MAX,0),out_of_range);
+    CHECK_THROWS(g.hex(0,INT_MAX),out_of_range);
+    CHECK_THROWS(g.hex(INT_MIN,0),out_of_range);
+    // Only a tile, and a path of four sectors down to it, for each of the
+    // four corners, below one root.
+    g.hex(far,0);
+    g.hex(0,far);
+    CHECK(counter.live()==1 + 4*(4+1));
+    // Off the far edges, and back.
+    CHECK(!corner->go(A) && !corner->go(B) && !corner->go(C));
+    CHECK(corner->go(D)==g.hex(far-1,far));
+    CHECK(corner->go(D)->go(A)==corner);
+    CHECK(corner->go(E)->go(B)==corner);
+    // Long moves land exactly, or fall off; they never wrap round.
+    CHECK(origin->go(A,far)==g.hex(far,0));
+    CHECK(!origin->go(A,INT_MAX));
+    CHECK(!g.hex(1,0)->go(A,far));
+    CHECK(!origin->go(D,1));
+    CHECK(!origin->go(A,-1)); // A huge distance, as a size_t.
+    CHECK(!corner->go(D,INT_MAX));
+    CHECK(corner->go(D,far)==g.hex(0,far));
+    CHECK(origin->go(B,far)->j==far);
+    // distance() needs more than an int between the corners.
+    CHECK(distance(origin,corner)==3*(size_t(1)<<30) - 3);
+    CHECK(distance(corner,origin)==distance(origin,corner));
+    CHECK(distance(g.hex(far,0),g.hex(0,far))==distance(origin,corner));
+    CHECK(distance(origin,g.hex(far,0))==size_t(far));
+  }
+  CHECK(counter.balanced());
+
+  // Grids that can't be made.
+  CHECK_THROWS(Grid(-1,5),out_of_range);
+  CHECK_THROWS(Grid(5,-1,Grid::DENSE),out_of_range);
+  CHECK_THROWS(Grid(INT_MAX,INT_MAX,Grid::DENSE),out_of_range);
+}
+
+
+struct Job
+{
+  const Grid*                  grid;
+  pthread_barrier_t*           barrier;
+  int                          first;  ///< Row to start at.
+  std::vector<const Hex*>      hexes;  ///< hex(i,j) at index i + j*cols.
+  std::vector<const Hex*>      steps;  ///< go(d) at index (i + j*cols)*6 + d.
+};
+
+
+void* run(void* arg)
+{
+  Job& job =*static_cast<Job*>(arg);
+  const Grid& g =*job.grid;
+  const int cols =g.cols();
+  const int rows =g.rows();
+  job.hexes.assign(size_t(cols) * rows,static_cast<const Hex*>(NULL));
+  job.steps.assign(size_t(cols) * rows * DIRECTIONS,static_cast<const Hex*>(NULL));
+  pthread_barrier_wait(job.barrier);
+  // Each thread starts on a different row, and wraps round, so that every
+  // thread visits every hex, and they all overlap.
+  for(int r=0; r<rows; ++r)
+  {
+    const int j =(job.first + r) % rows;
+    for(int i=0; i<cols; ++i)
+    {
+      const Hex* h =g.hex(i,j);
+      job.hexes[i + size_t(j) * cols] = h;
+      for(int d=0; d<DIRECTIONS; ++d)
+          job.steps[(i + size_t(j) * cols) * DIRECTIONS + d] = h->go(A+d);
+    }
+  }
+  return NULL;
+}
+
+
+void test_threads(void)
+{
+  const int THREADS =8;
+  for(int round=0; round<20; ++round)
+  {
+    Counting counter;
+    {
+      const Grid g(300,260,Grid::SPARSE,&counter);
+      pthread_barrier_t barrier;
+      pthread_barrier_init(&barrier,NULL,THREADS);
+      std::vector<Job> jobs(THREADS);
+      std::vector<pthread_t> threads(THREADS);
+      for(int t=0; t<THREADS; ++t)
+      {
+        jobs[t].grid = &g;
+        jobs[t].barrier = &barrier;
+        jobs[t].first = (t * g.rows()) / THREADS / 2;
+        pthread_create(&threads[t],NULL,run,&jobs[t]);
+      }
+      for(int t=0; t<THREADS; ++t)
+          pthread_join(threads[t],NULL);
+      pthread_barrier_destroy(&barrier);
+
+      // Every thread saw the same Hex for each (i,j), and its neighbours.
+      for(int t=1; t<THREADS; ++t)
+      {
+        CHECK(jobs[t].hexes==jobs[0].hexes);
+        CHECK(jobs[t].steps==jobs[0].steps);
+      }
+      bool right =true;
+      for(int j=0; j<g.rows(); ++j)
+        for(int i=0; i<g.cols(); ++i)
+        {
+          const Hex* h =jobs[0].hexes[i + size_t(j) * g.cols()];
+          right = right && h==g.hex(i,j) && h->i==i && h->j==j;
+          for(int d=0; d<DIRECTIONS; ++d)
+              right = right && jobs[0].steps[(i + size_t(j) * g.cols())
+                                             * DIRECTIONS + d]==h->go(A+d);
+        }
+      CHECK(right);
+
+      // Exactly one tile per 64x64 slot survives the races, plus the one
+      // sector that holds them: 5x5 tiles.
+      CHECK(counter.mismatches==0);
+      CHECK(counter.live()==5*5 + 1);
+      CHECK(counter.allocations - counter.deallocations==5*5 + 1);
+      CHECK(counter.live_bytes() ==
+            size_t(g.cols()) * g.rows() * sizeof(Hex) + 64*64*sizeof(Hex*));
+    }
+    CHECK(counter.balanced());
+  }
+}
+
+
+int main(void)
+{
+  test_storage();
+  test_allocator();
+  test_neighbours();
+  test_limits();
+  test_threads();
+  return check::report("test_grid");
+}
@@ -0,0 +1,64 @@
+// Checks that hex.js parses area strings exactly as Grid::area() does.
+// Reads test cases from "test_str --corpus" on stdin:
+//   first line:    cols rows
+//   "=STR\tHEXES"  STR must parse to the space-separated HEXES.
+//   "!STR"         STR must be rejected with invalid_argument.
+
+var fs =require('fs');
+var vm =require('vm');
+vm.runInThisContext( fs.readFileSync(__dirname+'/hex.js','utf8'), 'hex.js' );
+
+var lines =fs.readFileSync(0,'utf8').split('\n');
+var size =lines[0].split(' ');
+var grid =new HEX.Grid( parseInt(size[0],10), parseInt(size[1],10) );
+var failures =0;
+
+function fail(line,what)
+{
+  console.error('test_hexjs: '+what+': '+line);
+  ++failures;
+}
+
+for(var n=1; n<lines.length; ++n)
+{
+  var line =lines[n];
+  if(!line.length)
+      continue;
+  if(line.charAt(0)==='=')
+  {
+    var tab =line.indexOf('\t');
+    var got;
+    try
+    {
+      got =grid.area( line.substring(1,tab) ).hexes.map(String).sort();
+    }
+    catch(e)
+    {
+      fail(line,'threw '+e);
+      continue;
+    }
+    var expected =line.substring(tab+1).split(' ').sort();
+    if(got.join(' ')!==expected.join(' '))
+        fail(line,'parsed to '+got.join(' '));
+  }
+  else
+  {
+    try
+    {
+      grid.area( line.substring(1) );
+      fail(line,'accepted');
+    }
+    catch(e)
+    {
+      if(!(e instanceof HEX.exception) || e.kind!=='invalid_argument')
+          fail(line,'threw '+e);
+    }
+  }
+}
+
+if(failures)
+{
+  console.error('test_hexjs: '+failures+' check(s) failed');
+  process.exit(1);
+}
+console.log('test_hexjs: OK');
@@ -0,0 +1,185 @@
+// Behaviour tests for HexSet: membership, iteration order and set algebra,
+// checked against std::set.
+
+#include "check.h"
+#include "hex.h"
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace hex;
+
+
+/** Orders hexes the way a HexSet iterates them: by j, then by i. */
+struct RowMajor
+{
+  bool operator()(const Hex* a, const Hex* b) const
+    { return a->j<b->j || (a->j==b->j && a->i<b->i); }
+};
+
+typedef std::set<Hex*,RowMajor>  Reference;
+
+
+/** Up to n random hexes, scattered over the whole grid. */
+Reference random_hexes(const Grid& g, int n)
+{
+  Reference result;
+  for(int k=0; k<n; ++k)
+      result.insert( g.hex(check::random(g.cols()),check::random(g.rows())) );
+  return result;
+}
+
+
+HexSet to_hexset(const Grid& g, const Reference& r)
+{
+  // Insert in a random order, so that blocks are made out of order.
+  std::vector<Hex*> v(r.begin(),r.end());
+  for(size_t k=v.size(); k>1; --k)
+      std::swap( v[k-1], v[check::random(int(k))] );
+  HexSet result(g);
+  for(size_t k=0; k<v.size(); ++k)
+      CHECK( result.insert(v[k]) );
+  return result;
+}
+
+
+/** TRUE iff s has exactly the members of r, in the same order. */
+bool same(const HexSet& s, const Reference& r)
+{
+  if(s.size()!=r.size() || s.empty()!=r.empty())
+      return false;
+  if(!std::equal(r.begin(),r.end(),s.begin()))
+      return false;
+  for(Reference::const_iterator h=r.begin(); h!=r.end(); ++h)
+      if(!s.contains(*h) || s.count((**h).i,(**h).j)!=1)
+          return false;
+  return true;
+}
+
+
+void test_membership(const Grid& g)
+{
+  HexSet s(g);
+  CHECK( s.empty() && s.size()==0 && s.begin()==s.end() );
+  CHECK( s.insert(g.hex(3,4)) );
+  CHECK( !s.insert(g.hex(3,4)) );
+  CHECK( s.insert(7,0) );
+  CHECK( !s.insert(7,0) );
+  CHECK( s.size()==2 );
+  CHECK( *s.begin()==g.hex(7,0) );
+  CHECK( s.count(g.hex(3,4))==1 && s.count(3,4)==1 );
+  CHECK( s.count(4,3)==0 && s.count(-1,0)==0 && s.count(0,g.rows())==0 );
+  CHECK( s.erase(g.hex(3,4))==1 );
+  CHECK( s.erase(g.hex(3,4))==0 );
+  CHECK( s.size()==1 && !s.contains(g.hex(3,4)) );
+  CHECK_THROWS( s.insert(g.cols(),0), hex::out_of_range );
+  CHECK_THROWS( s.insert(static_cast<Hex*>(NULL)), hex::invalid_argument );
+  Grid other(g.cols(),g.rows());
+  CHECK_THROWS( s.insert(other.hex(0,0)), hex::invalid_argument );
+  CHECK( s.count(other.hex(7,0))==0 );
+  CHECK_THROWS( HexSet().insert(0,0), hex::invalid_argument );
+  // Like a std container, clear() only removes the members.
+  s.clear();
+  CHECK( s.empty() && s.size()==0 && s.begin()==s.end() && s.grid()==&g );
+  CHECK( s.insert(2,3) && s.size()==1 && s.count(2,3)==1 );
+  HexSet t(g);
+  t.clear();
+  CHECK( t.grid()==&g && t.insert(0,0) );
+  HexSet u;
+  u.clear();
+  CHECK( u.grid()==NULL );
+}
+
+
+void test_random(const Grid& g)
+{
+  for(int trial=0; trial<40; ++trial)
+  {
+    const int n =1 + check::random(trial<20? 50: 3000);
+    const Reference ra =random_hexes(g,n);
+    const Reference rb =random_hexes(g,n);
+    const HexSet a =to_hexset(g,ra);
+    const HexSet b =to_hexset(g,rb);
+    CHECK( same(a,ra) );
+    CHECK( a==to_hexset(g,ra) );
+    CHECK( a==HexSet(std::set<Hex*>(ra.begin(),ra.end())) );
+
+    Reference r_or, r_and, r_sub;
+    std::set_union(ra.begin(),ra.end(),rb.begin(),rb.end(),
+                   std::inserter(r_or,r_or.end()),RowMajor());
+    std::set_intersection(ra.begin(),ra.end(),rb.begin(),rb.end(),
+                          std::inserter(r_and,r_and.end()),RowMajor());
+    std::set_difference(ra.begin(),ra.end(),rb.begin(),rb.end(),
+                        std::inserter(r_sub,r_sub.end()),RowMajor());
+    HexSet s_or(a);  s_or  |= b;
+    HexSet s_and(a); s_and &= b;
+    HexSet s_sub(a); s_sub -= b;
+    CHECK( same(s_or,r_or) );
+    CHECK( same(s_and,r_and) );
+    CHECK( same(s_sub,r_sub) );
+    CHECK( (s_or==a) == (r_or==ra) );
+    HexSet s_self(a); s_self -= a;
+    CHECK( s_self.empty() && s_self==HexSet() );
+
+    // Erase half of the members, in a random order.
+    HexSet e(a);
+    Reference re(ra);
+    std::vector<Hex*> v(ra.begin(),ra.end());
+    for(size_t k=0; k<v.size(); ++k)
+        if(check::random(2))
+        {
+          CHECK( e.erase(v[k])==1 );
+          re.erase(v[k]);
+        }
+    CHECK( same(e,re) );
+    e |= a;
+    CHECK( e==a );
+
+    // Spans are sorted, disjoint and cover exactly the members.
+    const std::vector<Area::Span> spans =a.spans();
+    size_t total =0;
+    for(size_t k=0; k<spans.size(); ++k)
+    {
+      total += spans[k].i1 - spans[k].i0 + 1;
+      for(int i=spans[k].i0; i<=spans[k].i1; ++i)
+          CHECK( a.count(i,spans[k].j)==1 );
+      if(k)
+          CHECK( spans[k-1].j<spans[k].j ||
+                 spans[k-1].i1+1<spans[k].i0 );
+    }
+    CHECK( total==a.size() );
+
+    HexSet x(a), y(b);
+    x.swap(y);
+    CHECK( x==b && y==a );
+  }
+}
+
+
+void test_errors(const Grid& g)
+{
+  Grid other(g.cols(),g.rows());
+  HexSet a(g), b(other);
+  a.insert(0,0);
+  b.insert(0,0);
+  CHECK_THROWS( a|=b, hex::invalid_argument );
+  CHECK_THROWS( a&=b, hex::invalid_argument );
+  CHECK_THROWS( a-=b, hex::invalid_argument );
+  CHECK( a!=b );
+}
+
+
+int main()
+{
+  Grid small(20,15);
+  test_membership(small);
+  test_random(small);
+  Grid big(3000,2000); // Many blocks.
+  test_membership(big);
+  test_random(big);
+  test_errors(big);
+  return check::report("test_hexset");
+}
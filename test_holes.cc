@@ -0,0 +1,159 @@
+// Behaviour tests for Area::enclosed_areas() and Area::contours(), checked
+// against a breadth-first search of the hexes outside the area.
+
+#include "check.h"
+#include "hex.h"
+
+#include <deque>
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace hex;
+
+
+/** Reference holes: the components of the hexes not in a that never reach
+ *  the edge of the grid, in order of their first hex. */
+std::vector< std::set<Hex*> > reference(const Grid& g, const Area& a)
+{
+  std::vector< std::set<Hex*> > result;
+  std::set<Hex*> seen;
+  for(int j=0; j<g.rows(); ++j)
+    for(int i=0; i<g.cols(); ++i)
+    {
+      Hex* h =g.hex(i,j);
+      if(a.contains(h) || seen.count(h))
+          continue;
+      std::set<Hex*> component;
+      bool open =false;
+      std::deque<Hex*> queue(1,h);
+      seen.insert(h);
+      while(!queue.empty())
+      {
+        Hex* x =queue.front();
+        queue.pop_front();
+        component.insert(x);
+        for(int d=0; d<DIRECTIONS; ++d)
+        {
+          Hex* n =x->go(A+d);
+          if(!n)
+              open = true;
+          else if(!a.contains(n) && seen.insert(n).second)
+              queue.push_back(n);
+        }
+      }
+      if(!open)
+          result.push_back(component);
+    }
+  return result;
+}
+
+
+/** A random connected area: the largest component of a random set. */
+Area random_area(const Grid& g)
+{
+  HexSet s(g);
+  const int n =g.cols() * g.rows() * (40 + check::random(40)) / 100;
+  for(int k=0; k<n; ++k)
+      s.insert( check::random(g.cols()), check::random(g.rows()) );
+  const std::list<Area> all =areas(s);
+  Area result;
+  for(std::list<Area>::const_iterator a=all.begin(); a!=all.end(); ++a)
+      if(a->size()>result.size())
+          result = *a;
+  return result;
+}
+
+
+/** Checks enclosed_areas() and contours() for a, in both storages. */
+void check_holes(const Grid& g, const Area& area)
+{
+  const std::vector< std::set<Hex*> > expected =reference(g,area);
+  const Area* both[] = { &area, 0 };
+  const Area other(area, area.storage()==Area::HEXES? Area::SPANS: Area::HEXES);
+  both[1] = &other;
+  for(int k=0; k<2; ++k)
+  {
+    const Area& a =*both[k];
+    const std::list<Area> holes =a.enclosed_areas();
+    CHECK( holes.size()==expected.size() );
+    std::list<Area>::const_iterator h =holes.begin();
+    for(size_t n=0; h!=holes.end() && n<expected.size(); ++h, ++n)
+        CHECK( h->hexes()==expected[n] );
+
+    const std::list<Boundary> contours =a.contours();
+    CHECK( contours.size()==1+expected.size() );
+    if(contours.empty())
+        continue;
+    CHECK( contours.front().edges()==a.boundary().edges() );
+    std::list<Boundary>::const_iterator c =contours.begin();
+    ++c;
+    for(size_t n=0; c!=contours.end() && n<expected.size(); ++c, ++n)
+    {
+      // Each hole's contour is its own boundary: closed, and made of
+      // exactly the edges of the hole's hexes that face the area.
+      CHECK( c->is_closed() );
+      size_t edges =0;
+      for(std::set<Hex*>::const_iterator x=expected[n].begin();
+          x!=expected[n].end(); ++x)
+          for(int d=0; d<DIRECTIONS; ++d)
+              if(a.contains( (**x).go(A+d) ))
+                  ++edges;
+      CHECK( c->edges().size()==edges );
+      for(std::list<Edge*>::const_iterator e=c->edges().begin();
+          e!=c->edges().end(); ++e)
+      {
+        CHECK( expected[n].count( (**e).hex() ) );
+        CHECK( a.contains( (**e).hex()->go((**e).direction()) ) );
+      }
+    }
+  }
+}
+
+
+void test_cases(const Grid& g)
+{
+  Hex* centre =g.hex(12,10);
+  const Area disc(centre,5);
+  check_holes(g,disc);
+  CHECK( disc.enclosed_areas().empty() );
+
+  // One hole, of one hex.
+  std::set<Hex*> hexes =disc.hexes();
+  hexes.erase(centre);
+  const Area one(hexes);
+  check_holes(g,one);
+  CHECK( one.enclosed_areas().size()==1 );
+
+  // Two holes, one of them big.
+  const Spiral inner =spiral(g.hex(10,10),1);
+  for(Spiral::const_iterator h=inner.begin(); h!=inner.end(); ++h)
+      hexes.erase(*h);
+  hexes.erase(g.hex(15,10));
+  const Area two(hexes);
+  check_holes(g,two);
+  CHECK( two.enclosed_areas().size()==2 );
+
+  // A gap that reaches the edge of the grid is not a hole.
+  std::set<Hex*> edge;
+  for(int i=0; i<5; ++i)
+  {
+    edge.insert( g.hex(i,1) );
+    if(i!=2)
+        edge.insert( g.hex(i,0) );
+  }
+  const Area notch(edge);
+  check_holes(g,notch);
+  CHECK( notch.enclosed_areas().empty() );
+}
+
+
+int main()
+{
+  Grid g(25,20);
+  test_cases(g);
+  for(int trial=0; trial<200; ++trial)
+      check_holes(g,random_area(g));
+  return check::report("test_holes");
+}
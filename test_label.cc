@@ -0,0 +1,164 @@
+// Behaviour tests for connected-component labelling: label(), areas() and
+// is_connected(), checked against a breadth-first search. Band-parallel
+// labelling must give exactly the same labels as serial labelling.
+
+#include "check.h"
+#include "hex.h"
+
+#include <deque>
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace hex;
+
+typedef std::vector<Area::Span>  Spans;
+
+
+/** Reference labels: breadth-first search from each unlabelled member, in
+ *  row-major order, so components are numbered by their first hex. */
+std::map<Hex*,size_t> reference(const HexSet& s, size_t& count)
+{
+  std::map<Hex*,size_t> result;
+  count = 0;
+  for(HexSet::const_iterator h=s.begin(); h!=s.end(); ++h)
+  {
+    if(result.count(*h))
+        continue;
+    std::deque<Hex*> queue(1,*h);
+    result[*h] = count;
+    while(!queue.empty())
+    {
+      Hex* x =queue.front();
+      queue.pop_front();
+      for(int d=0; d<DIRECTIONS; ++d)
+      {
+        Hex* n =x->go(A+d);
+        if(n && s.contains(n) && !result.count(n))
+        {
+          result[n] = count;
+          queue.push_back(n);
+        }
+      }
+    }
+    ++count;
+  }
+  return result;
+}
+
+
+/** Checks label(), areas() & is_connected() on s, with the given threads. */
+void check_labels(const HexSet& s, unsigned threads)
+{
+  size_t count;
+  std::map<Hex*,size_t> expected =reference(s,count);
+  const Spans spans =s.spans();
+  std::vector<size_t> labels;
+  CHECK( label(spans,labels,threads)==count );
+  CHECK( labels.size()==spans.size() );
+  const Grid& g =*s.grid();
+  for(size_t n=0; n<spans.size() && n<labels.size(); ++n)
+      for(int i=spans[n].i0; i<=spans[n].i1; ++i)
+          CHECK( labels[n]==expected[g.hex(i,spans[n].j)] );
+
+  // areas() lists the components in the same order.
+  const std::list<Area> by_hexset =areas(s,threads);
+  const std::list<Area> by_set =areas(s.hexes(),threads);
+  CHECK( by_hexset.size()==count && by_set.size()==count );
+  size_t c =0;
+  std::list<Area>::const_iterator a=by_hexset.begin(), b=by_set.begin();
+  for(; a!=by_hexset.end() && b!=by_set.end(); ++a, ++b, ++c)
+  {
+    CHECK( a->hexes()==b->hexes() );
+    for(std::set<Hex*>::const_iterator h=a->hexes().begin();
+        h!=a->hexes().end(); ++h)
+        CHECK( expected[*h]==c );
+  }
+
+  CHECK( is_connected(s)==(count<=1) );
+  CHECK( is_connected(s.hexes())==(count<=1) );
+  CHECK( is_connected(spans)==(count<=1) );
+}
+
+
+void test_random(const Grid& g, unsigned threads)
+{
+  for(int trial=0; trial<150; ++trial)
+  {
+    check_labels( check::random_hexset(g, check::random(65)), threads );
+  }
+}
+
+
+void test_cases(const Grid& g, unsigned threads)
+{
+  check_labels( HexSet(g), threads );
+  HexSet one(g);
+  one.insert(5,5);
+  check_labels( one, threads );
+  const Area disc(g.hex(10,10),6);
+  check_labels( HexSet(disc.hexes()), threads );
+
+  // A ring is one component, and the hexes it encloses are another.
+  const Spiral r =ring(g.hex(10,10),4);
+  HexSet rings(std::set<Hex*>(r.begin(),r.end()));
+  rings.insert(10,10);
+  check_labels( rings, threads );
+
+  // A zig-zag that is only joined through its odd & even row offsets.
+  HexSet zig(g);
+  for(int j=0; j<g.rows(); ++j)
+      zig.insert( 3 - (j&1), j );
+  check_labels( zig, threads );
+  size_t count;
+  reference(zig,count);
+  CHECK( count==1 );
+
+  // Hex 3,2 is in an even row, so it touches i=2,3 in row 3, but not i=4.
+  HexSet pair(g);
+  pair.insert(3,2);
+  pair.insert(4,3);
+  check_labels( pair, threads );
+  reference(pair,count);
+  CHECK( count==2 );
+}
+
+
+/** Every thread count gives the same labels as one thread. */
+void test_threads(const Grid& g)
+{
+  const unsigned threads[] = { 2, 3, 4, 7, 16, 64 };
+  for(int trial=0; trial<100; ++trial)
+  {
+    const HexSet s =check::random_hexset(g, check::random(65));
+    const Spans spans =s.spans();
+    std::vector<size_t> serial;
+    const size_t count =label(spans,serial,1);
+    for(size_t t=0; t<sizeof(threads)/sizeof(threads[0]); ++t)
+    {
+      std::vector<size_t> parallel;
+      CHECK( label(spans,parallel,threads[t])==count );
+      CHECK( parallel==serial );
+    }
+  }
+}
+
+
+int main()
+{
+  Grid g(30,25);
+  test_random(g,1);
+  test_cases(g,1);
+  // More threads than rows, and bands only a row or two high.
+  for(unsigned threads=2; threads<=32; threads*=2)
+  {
+    test_random(g,threads);
+    test_cases(g,threads);
+  }
+  // Components that snake across many band seams.
+  Grid tall(12,400);
+  test_threads(tall);
+  test_cases(tall,8);
+  return check::report("test_label");
+}
@@ -0,0 +1,111 @@
+// Behaviour tests for dilate, erode, opening, closing and distance_layers,
+// checked against their definitions in terms of hex::distance().
+
+#include "check.h"
+#include "hex.h"
+
+#include <vector>
+
+using namespace hex;
+
+
+/** Steps from h to the nearest hex in s (if in is TRUE), or to the nearest
+ *  hex on the grid that is not in s. Returns size_t(-1) if there is none. */
+size_t nearest(const Grid& g, const HexSet& s, const Hex* h, bool in)
+{
+  size_t result =size_t(-1);
+  for(int j=0; j<g.rows(); ++j)
+    for(int i=0; i<g.cols(); ++i)
+      if(s.count(i,j)==size_t(in))
+          result = std::min( result, distance(h,g.hex(i,j)) );
+  return result;
+}
+
+
+HexSet reference_dilate(const Grid& g, const HexSet& s, size_t r)
+{
+  HexSet result(g);
+  for(int j=0; j<g.rows(); ++j)
+    for(int i=0; i<g.cols(); ++i)
+    {
+      const size_t d =nearest(g,s,g.hex(i,j),true);
+      if(d!=size_t(-1) && d<=r)
+          result.insert(i,j);
+    }
+  return result;
+}
+
+
+HexSet reference_erode(const Grid& g, const HexSet& s, size_t r)
+{
+  HexSet result(g);
+  for(HexSet::const_iterator h=s.begin(); h!=s.end(); ++h)
+  {
+    const size_t d =nearest(g,s,*h,false);
+    if(d==size_t(-1) || d>r)
+        result.insert(*h);
+  }
+  return result;
+}
+
+
+void check_morphology(const Grid& g, const HexSet& s)
+{
+  for(size_t r=0; r<=3; ++r)
+  {
+    const HexSet d =dilate(s,r);
+    const HexSet e =erode(s,r);
+    CHECK( d==reference_dilate(g,s,r) );
+    CHECK( e==reference_erode(g,s,r) );
+    const HexSet o =opening(s,r);
+    const HexSet c =closing(s,r);
+    CHECK( o==dilate(e,r) );
+    CHECK( c==erode(d,r) );
+    HexSet extra(o);
+    extra -= s;
+    CHECK( extra.empty() ); // opening(s) is a subset of s.
+    HexSet missing(s);
+    missing -= c;
+    CHECK( missing.empty() ); // s is a subset of closing(s).
+    CHECK( opening(o,r)==o && closing(c,r)==c ); // Both are idempotent.
+  }
+
+  // Layer k holds the hexes k+1 steps from the nearest hex outside s.
+  const std::vector<HexSet> layers =distance_layers(s);
+  HexSet all(g);
+  for(size_t k=0; k<layers.size(); ++k)
+  {
+    CHECK( !layers[k].empty() );
+    for(HexSet::const_iterator h=layers[k].begin(); h!=layers[k].end(); ++h)
+        CHECK( nearest(g,s,*h,false)==k+1 );
+    all |= layers[k];
+  }
+  if(nearest(g,s,g.hex(0,0),false)==size_t(-1))
+      CHECK( layers.empty() ); // s fills the grid.
+  else
+      CHECK( all==s );
+  // erode(s,r) is the union of the layers after the first r.
+  for(size_t r=0; r<=layers.size(); ++r)
+  {
+    HexSet deeper(g);
+    for(size_t k=r; k<layers.size(); ++k)
+        deeper |= layers[k];
+    if(!layers.empty())
+        CHECK( erode(s,r)==deeper );
+  }
+}
+
+
+int main()
+{
+  Grid g(14,12);
+  check_morphology(g,HexSet(g));
+  check_morphology(g,HexSet(g.to_area().hexes()));
+  HexSet one(g);
+  one.insert(6,6);
+  check_morphology(g,one);
+  check_morphology(g,HexSet(Area(g.hex(6,5),4).hexes()));
+  for(int trial=0; trial<40; ++trial)
+      check_morphology(g,check::random_hexset(g,10+check::random(85)));
+  return check::report("test_morphology");
+}
@@ -0,0 +1,199 @@
+// Behaviour tests for the routing engine: best_path must find exactly the
+// paths that the original search (a std::multiset of _Routes) found, ties
+// must break first in, first out, searches must cost time in proportion
+// to the hexes they explore, not to the size of the grid, and a re-used
+// SearchContext must forget every earlier search.
+
+#include "move_check.h"
+
+#include <set>
+#include <vector>
+
+using namespace hex;
+
+
+namespace hex {
+namespace move {
+
+/** Test hook: lets a context run through its generations of stamps quickly,
+ *  so that start() has to wrap round. */
+struct SearchContextTest
+{
+  static void wrap_after(SearchContext& c, SearchContext::Stamp generations)
+    { c._last_generation = generations; }
+};
+
+} // end namespace move
+} // end namespace hex
+
+
+/** A Topography that can also search the old way. */
+class Reference: public check::Probe
+{
+public:
+  Reference(void) {}
+  Reference(move::Cost default_hex_cost): check::Probe(default_hex_cost) {}
+
+  /** best_path() as it was, copying a whole _Route at every step. */
+  Path multiset_best_path(Hex* start, Hex* goal) const
+    {
+      std::set<Hex*> visited;
+      std::multiset<move::_Route> queue;
+      queue.insert( move::_Route::factory(start,goal) );
+      while(!queue.empty())
+      {
+        move::_Route curr_route = *queue.begin();
+        queue.erase( queue.begin() );
+        Hex* curr_hex = curr_route.path.back();
+        if(visited.count(curr_hex))
+            continue;
+        if(curr_hex==goal)
+            return Path(curr_route.path);
+        visited.insert(curr_hex);
+        for(int dir=0; dir<DIRECTIONS; ++dir)
+        {
+          Step s = step(curr_hex,A+dir);
+          if(s.to_hex && 0==visited.count(s.to_hex))
+              queue.insert( curr_route.step(s.to_hex,s.cost,goal) );
+        }
+      }
+      throw move::no_solution("multiset_best_path");
+    }
+};
+
+
+/** The same path, or no path, from best_path() in all its forms and from
+ *  the multiset search. */
+void test_same_paths(void)
+{
+  move::SearchContext reused;
+  for(int t=0; t<300; ++t)
+  {
+    Grid g(5+check::random(40),5+check::random(40));
+    Reference r =( t%5==0? Reference(): Reference(t%2? 1.0: 0.5) );
+    check::scatter(g,r);
+    move::SearchContext dense(g);
+    Hex* a =check::any_hex(g);
+    Hex* b =check::any_hex(g);
+    std::string expected;
+    try
+    {
+      expected = r.multiset_best_path(a,b).str();
+    }
+    catch(move::no_solution&)
+    {
+      CHECK_THROWS(r.best_path(a,b),move::no_solution);
+      CHECK_THROWS(r.best_path(a,b,reused),move::no_solution);
+      CHECK_THROWS(r.best_path(a,b,dense),move::no_solution);
+      continue;
+    }
+    CHECK(r.best_path(a,b).str()==expected);
+    CHECK(r.best_path(a,b,reused).str()==expected);
+    CHECK(r.best_path(a,b,dense).str()==expected);
+  }
+}
+
+
+/** Equal offers pop in the order they were pushed. */
+void test_fifo_ties(move::SearchContext& context, const Grid& g)
+{
+  // No goal, so the value of each offer is just its cost.
+  context.start(g);
+  Hex* origin =g.hex(20,20);
+  const size_t root =context.index(origin);
+  std::set<size_t> offered;
+  std::vector<size_t> order;
+  for(int k=0; k<50; ++k)
+  {
+    Hex* h =check::any_hex(g);
+    if(h==origin || !offered.insert(context.index(h)).second)
+        continue;
+    context.push(h,root,3.0);
+    order.push_back(context.index(h));
+  }
+  context.push(origin,root,3.0); // Last in, so last out.
+  order.push_back(root);
+  // A cheaper offer comes first, and a dearer one changes nothing.
+  Hex* cheap =g.hex(41,41);
+  context.push(cheap,root,1.0);
+  context.push(context.hex(order[0]),root,5.0);
+
+  move::SearchContext::Entry e;
+  CHECK(context.pop(e) && e.node==context.index(cheap) && e.cost==1.0);
+  for(size_t k=0; k<order.size(); ++k)
+  {
+    CHECK(context.pop(e));
+    CHECK(e.node==order[k] && e.cost==3.0);
+    CHECK(context.is_closed(e.node));
+  }
+  CHECK(!context.pop(e));
+  CHECK(context.path(order[0]).size()==2);
+  CHECK(context.path(root).size()==1);
+}
+
+
+/** A search takes no memory for hexes it never reaches: a default context
+ *  could not hold a flat array for every hex in this grid. */
+void test_huge_grid(void)
+{
+  Grid g(1<<20,1<<20);
+  move::Topography t(1.0);
+  Hex* a =g.hex(500000,700000);
+  Hex* b =g.hex(500003,700001);
+  const size_t steps =hex::distance(a,b);
+  CHECK(t.best_path(a,b).hexes().size()==steps+1);
+  CHECK(t.best_path_bidirectional(a,b).hexes().size()==steps+1);
+  CHECK(t.horizon(a,2.0).size()==19);
+  move::SearchContext context;
+  for(int k=0; k<1000; ++k) // Many searches, re-using the hash table.
+  {
+    Hex* c =check::any_hex(g);
+    Hex* d =c->go(A+check::random(DIRECTIONS));
+    if(d)
+        CHECK(t.best_path(c,d,context).hexes().size()==2);
+  }
+}
+
+
+/** Many more searches than there are generations of stamps. No hex
+ *  reached by the previous search may seem reached by the next. */
+void test_wraparound(move::SearchContext& context)
+{
+  Grid g(8,8);
+  move::Topography t(1.0);
+  move::SearchContextTest::wrap_after(context,37);
+  for(int k=0; k<2000; ++k)
+  {
+    Hex* a =check::any_hex(g);
+    Hex* b =check::any_hex(g);
+    if(k%2) // Sometimes an extra start(), so that either one may wrap.
+        context.start(g,b);
+    if(!CHECK(t.best_path(a,b,context).hexes().size()==distance(a,b)+1))
+        break;
+    if(!CHECK(context.is_closed(context.index(b))))
+        break;
+    context.start(g,b);
+    size_t reached =0;
+    for(int n=0; n<g.cols()*g.rows(); ++n)
+        if(context.has_cost(n))
+            ++reached;
+    if(!CHECK(reached==0))
+        break;
+  }
+}
+
+
+int main(void)
+{
+  test_same_paths();
+  Grid g(60,50);
+  move::SearchContext sparse;
+  move::SearchContext dense(g);
+  test_fifo_ties(sparse,g);
+  test_fifo_ties(dense,g);
+  test_fifo_ties(sparse,g); // Again, after a search has been forgotten.
+  test_huge_grid();
+  test_wraparound(sparse);
+  test_wraparound(dense);
+  return check::report("test_move");
+}
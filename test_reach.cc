@@ -0,0 +1,169 @@
+// Behaviour tests for the reachability index: after every kind of cost
+// change, is_reachable() must match a breadth-first search of the hexes
+// that can be entered, joined by moves in one direction or the other, and
+// must never deny a route that best_path could find.
+
+#include "move_check.h"
+
+#include <deque>
+#include <map>
+#include <set>
+
+using namespace hex;
+using check::Probe;
+
+
+/** Component labels of the hexes that have costs (all of them, if t has a
+ *  default), joined wherever a move goes one way or the other between
+ *  them. Other hexes are unlabelled. */
+std::map<Hex*,int> components(const Grid& g, const Probe& t, bool all)
+{
+  std::set<Hex*> enterable =t.accessible();
+  if(all)
+    for(int j=0; j<g.rows(); ++j)
+      for(int i=0; i<g.cols(); ++i)
+          enterable.insert(g.hex(i,j));
+  std::map<Hex*,int> result;
+  int label =0;
+  for(std::set<Hex*>::const_iterator h =enterable.begin(); h!=enterable.end(); ++h)
+  {
+    if(result.count(*h))
+        continue;
+    result[*h] = ++label;
+    std::deque<Hex*> queue(1,*h);
+    while(!queue.empty())
+    {
+      Hex* x =queue.front();
+      queue.pop_front();
+      for(int d=0; d<DIRECTIONS; ++d)
+      {
+        Hex* n =x->go(A+d);
+        if(n && enterable.count(n) && !result.count(n) &&
+           (t.can_step(x,A+d) || t.can_step(n,A+d+3)))
+        {
+          result[n] = label;
+          queue.push_back(n);
+        }
+      }
+    }
+  }
+  return result;
+}
+
+
+/** TRUE iff some route of moves leads from a to b. */
+bool route(const Probe& t, Hex* a, Hex* b)
+{
+  std::set<Hex*> seen;
+  std::deque<Hex*> queue(1,a);
+  seen.insert(a);
+  while(!queue.empty())
+  {
+    Hex* x =queue.front();
+    queue.pop_front();
+    if(x==b)
+        return true;
+    for(int d=0; d<DIRECTIONS; ++d)
+      if(t.can_step(x,A+d) && seen.insert(x->go(A+d)).second)
+          queue.push_back(x->go(A+d));
+  }
+  return false;
+}
+
+
+/** One random change of costs. Every kind of change can make hexes
+ *  enterable, or (with override_hex_cost) drop edge costs. */
+void edit(const Grid& g, Probe& t)
+{
+  Hex* h =check::any_hex(g);
+  Edge* e =h->edge(A+check::random(DIRECTIONS));
+  switch(check::random(7))
+  {
+    case 0: t.override_hex_cost(h,0.5 + check::random(3));      break;
+    case 1: t.increase_hex_cost(h,check::random(3));            break;
+    case 2: t.override_edge_cost(e,0.25 * (1+check::random(8))); break;
+    case 3: t.override_edge_cost(e,1); // Then lose it again.
+            t.override_hex_cost(e->hex(),2);                     break;
+    case 4: t.increase_edge_cost(e,check::random(3));            break;
+    case 5:
+      {
+        std::set<Hex*> s;
+        for(int k=0; k<4; ++k)
+            s.insert(check::any_hex(g));
+        t.override_cost(s,1);
+      }
+      break;
+    case 6: t.increase_cost(Area(h,1),1);                        break;
+  }
+}
+
+
+void test_reachability(void)
+{
+  for(int t=0; t<60; ++t)
+  {
+    Grid g(4+check::random(15),4+check::random(15));
+    Probe topo =( t%6? Probe(): Probe(2.0) );
+    const bool all =( t%6==0 );
+    for(int k=0; k<check::random(g.cols()); ++k)
+        edit(g,topo);
+    if(t%2)
+        topo.index_reachability(g);
+    else
+        topo.compile(g);
+    for(int k=0; k<2*g.cols(); ++k)
+    {
+      edit(g,topo);
+      const std::map<Hex*,int> label =components(g,topo,all);
+      Probe fresh =topo;
+      fresh.index_reachability(g);
+      for(int q=0; q<10; ++q)
+      {
+        Hex* a =check::any_hex(g);
+        Hex* b =check::any_hex(g);
+        // a itself need not be enterable: look at its first step.
+        bool joined =( a==b );
+        std::map<Hex*,int>::const_iterator lb =label.find(b);
+        for(int d=0; d<DIRECTIONS && !joined && lb!=label.end(); ++d)
+        {
+          std::map<Hex*,int>::const_iterator la =label.find(a->go(A+d));
+          joined = ( la!=label.end() && la->second==lb->second );
+        }
+        CHECK(topo.is_reachable(a,b)==joined);
+        CHECK(fresh.is_reachable(a,b)==joined);
+        if(route(topo,a,b))
+            CHECK(topo.is_reachable(a,b));
+      }
+    }
+  }
+}
+
+
+/** A start that can't be entered can still be left. */
+void test_unenterable_start(void)
+{
+  Grid g(10,10);
+  Probe t;
+  Hex* x =g.hex(5,5);
+  t.override_hex_cost(x,1);
+  t.index_reachability(g);
+  Hex* a =x->go(D); // One step from x, along direction A.
+  Hex* y =x->go(A);
+  CHECK(t.is_reachable(a,x));
+  CHECK(t.best_path(a,x).hexes().size()==2);
+  CHECK(!t.is_reachable(a,y));
+  CHECK_THROWS(t.best_path(a,y),move::no_solution);
+  // Now y can be entered from x, across y's edge D.
+  t.override_edge_cost(y->edge(D),1);
+  CHECK(t.is_reachable(a,y));
+  CHECK(t.best_path(a,y).hexes().size()==3);
+  CHECK(!t.is_reachable(y,x->go(F)));
+}
+
+
+int main(void)
+{
+  test_reachability();
+  test_unenterable_start();
+  return check::report("test_reach");
+}
@@ -0,0 +1,231 @@
+// Behaviour tests for Region: size, perimeter, edges, components and holes
+// (from the Euler characteristic) as hexes are added & removed, checked
+// against a breadth-first search after every change.
+
+#include "check.h"
+#include "hex.h"
+
+#include <deque>
+#include <set>
+
+using namespace hex;
+
+
+/** The number of components of the members (if members is TRUE) or of the
+ *  non-members of r. Components of non-members that reach the edge of the
+ *  grid are not counted, so they are the holes. */
+size_t count_components(const Grid& g, const Region& r, bool members)
+{
+  size_t result =0;
+  std::set<Hex*> seen;
+  for(int j=0; j<g.rows(); ++j)
+    for(int i=0; i<g.cols(); ++i)
+    {
+      Hex* h =g.hex(i,j);
+      if(r.contains(h)!=members || !seen.insert(h).second)
+          continue;
+      bool open =false;
+      std::deque<Hex*> queue(1,h);
+      while(!queue.empty())
+      {
+        Hex* x =queue.front();
+        queue.pop_front();
+        for(int d=0; d<DIRECTIONS; ++d)
+        {
+          Hex* n =x->go(A+d);
+          if(!n)
+              open = true;
+          else if(r.contains(n)==members && seen.insert(n).second)
+              queue.push_back(n);
+        }
+      }
+      if(members || !open)
+          ++result;
+    }
+  return result;
+}
+
+
+void check_region(const Grid& g, const Region& r, const std::set<Hex*>& ref)
+{
+  CHECK( r.size()==ref.size() );
+  CHECK( r.empty()==ref.empty() );
+  CHECK( r.hexes()==HexSet(ref) );
+  std::set<Edge*> edges;
+  for(std::set<Hex*>::const_iterator h=ref.begin(); h!=ref.end(); ++h)
+    for(int d=0; d<DIRECTIONS; ++d)
+    {
+      Hex* n =(**h).go(A+d);
+      if(!n || !ref.count(n))
+          edges.insert( (**h).edge(A+d) );
+    }
+  CHECK( r.perimeter()==edges.size() );
+  CHECK( r.edges()==edges );
+  const size_t components =count_components(g,r,true);
+  CHECK( r.components()==components );
+  CHECK( r.holes()==count_components(g,r,false) );
+  CHECK( r.is_connected()==(components<=1) );
+  if(components==1)
+      CHECK( r.to_area().hexes()==ref );
+}
+
+
+void test_random(const Grid& g)
+{
+  for(int trial=0; trial<30; ++trial)
+  {
+    Region r;
+    std::set<Hex*> ref;
+    // Bias towards adding or removing, so that the region grows & shrinks.
+    const int bias =30 + check::random(40);
+    for(int step=0; step<400; ++step)
+    {
+      Hex* h =g.hex( check::random(g.cols()), check::random(g.rows()) );
+      if(check::random(100)<bias)
+          CHECK( r.add(h)==ref.insert(h).second );
+      else
+          CHECK( r.remove(h)==(ref.erase(h)>0) );
+      // Sometimes several changes go by without a query, so that the
+      // components stay unknown for a while.
+      if(check::random(4)==0)
+          check_region(g,r,ref);
+    }
+    check_region(g,r,ref);
+  }
+}
+
+
+void test_cases(const Grid& g)
+{
+  Region r;
+  std::set<Hex*> ref;
+  check_region(g,r,ref);
+  CHECK( !r.remove(g.hex(1,1)) );
+
+  // A ring of six round a hex has one hole, until the hex is added.
+  Hex* centre =g.hex(8,8);
+  const Spiral six =ring(centre,1);
+  for(Spiral::const_iterator h=six.begin(); h!=six.end(); ++h)
+  {
+    r.add(*h);
+    ref.insert(*h);
+  }
+  check_region(g,r,ref);
+  CHECK( r.holes()==1 && r.perimeter()==6*6-2*6 );
+  r.add(centre);
+  ref.insert(centre);
+  check_region(g,r,ref);
+  CHECK( r.holes()==0 );
+  CHECK( !r.add(centre) );
+
+  // Cutting the ring in two, then joining it again.
+  r.remove(centre);
+  r.remove(*six.begin());
+  ref.erase(centre);
+  ref.erase(*six.begin());
+  check_region(g,r,ref);
+  CHECK( r.holes()==0 && r.components()==1 );
+  Spiral::const_iterator opposite =six.begin();
+  std::advance(opposite,3);
+  r.remove(*opposite);
+  ref.erase(*opposite);
+  check_region(g,r,ref);
+  CHECK( r.components()==2 );
+  r.add(*six.begin());
+  ref.insert(*six.begin());
+  check_region(g,r,ref);
+  CHECK( r.components()==1 );
+
+  // A hex in the corner of the grid has edges that face off the grid.
+  Region corner;
+  corner.add(g.hex(0,0));
+  CHECK( corner.perimeter()==6 && corner.holes()==0 );
+
+  // Constructing from an Area.
+  const Area disc(g.hex(10,10),3);
+  const Region from(disc);
+  check_region(g,from,disc.hexes());
+
+  // Repeated churn, with the components known after every change, so that
+  // the union-find keeps growing until it is compacted.
+  Region churn;
+  std::set<Hex*> cref;
+  for(int k=0; k<5000; ++k)
+  {
+    Hex* h =g.hex(10+check::random(3),10+check::random(3));
+    if(churn.contains(h))
+    {
+      churn.remove(h);
+      cref.erase(h);
+    }
+    else
+    {
+      churn.add(h);
+      cref.insert(h);
+    }
+    CHECK( churn.components()==count_components(g,churn,true) );
+  }
+  check_region(g,churn,cref);
+}
+
+
+/** Removals with the components known before each one, so that every cut
+ *  is found by remove()'s own search: parts cut off on either side, and
+ *  long ways round. */
+void test_removal(const Grid& g)
+{
+  // A wide ring: cutting it once leaves a long way round; twice, two arcs.
+  Region r;
+  std::set<Hex*> ref;
+  const Spiral wide =ring(g.hex(9,9),7);
+  for(Spiral::const_iterator h=wide.begin(); h!=wide.end(); ++h)
+  {
+    r.add(*h);
+    ref.insert(*h);
+  }
+  CHECK( r.components()==1 && r.holes()==1 );
+  Spiral::const_iterator h =wide.begin();
+  for(int k=0; k<3; ++k)
+  {
+    r.remove(*h);
+    ref.erase(*h);
+    std::advance(h,10);
+    check_region(g,r,ref);
+  }
+  CHECK( r.components()==3 );
+
+  // Eat away at discs in random order.
+  for(int trial=0; trial<20; ++trial)
+  {
+    const Area disc(g.hex(9,9),4+check::random(5));
+    Region d(disc);
+    std::set<Hex*> dref =disc.hexes();
+    while(!dref.empty())
+    {
+      std::set<Hex*>::iterator x =dref.begin();
+      std::advance(x,check::random(int(dref.size())));
+      CHECK( d.remove(*x) );
+      dref.erase(x);
+      CHECK( d.components()==count_components(g,d,true) );
+      if(check::random(8)==0)
+          check_region(g,d,dref);
+      // Sometimes put a hex back, to join the parts again.
+      if(check::random(3)==0)
+      {
+        Hex* back =g.hex(9+check::random(9)-4,9+check::random(9)-4);
+        if(disc.hexes().count(back) && d.add(back))
+            dref.insert(back);
+      }
+    }
+  }
+}
+
+
+int main()
+{
+  Grid g(20,18);
+  test_cases(g);
+  test_random(g);
+  test_removal(g);
+  return check::report("test_region");
+}
@@ -0,0 +1,146 @@
+// Behaviour tests for span lists: span_union, span_intersection and
+// span_difference against HexSet algebra, and Area's SPANS storage.
+
+#include "check.h"
+#include "hex.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace hex;
+
+typedef std::vector<Area::Span>  Spans;
+
+
+/** Random spans, sorted but possibly overlapping or touching. */
+Spans random_spans(const Grid& g, int n)
+{
+  Spans result;
+  for(int k=0; k<n; ++k)
+  {
+    const int j  =check::random(g.rows());
+    const int i0 =check::random(g.cols());
+    const int i1 =std::min(g.cols()-1, i0 + check::random(8));
+    result.push_back( Area::Span(j,i0,i1) );
+  }
+  std::sort(result.begin(),result.end());
+  return result;
+}
+
+
+HexSet to_hexset(const Grid& g, const Spans& spans)
+{
+  HexSet result(g);
+  for(Spans::const_iterator s=spans.begin(); s!=spans.end(); ++s)
+      for(int i=s->i0; i<=s->i1; ++i)
+          result.insert(i,s->j);
+  return result;
+}
+
+
+/** TRUE iff spans are sorted, and never overlap or touch. */
+bool is_normal(const Spans& spans)
+{
+  for(size_t k=0; k<spans.size(); ++k)
+  {
+    if(spans[k].i1<spans[k].i0)
+        return false;
+    if(k && !( spans[k-1].j<spans[k].j ||
+               (spans[k-1].j==spans[k].j && spans[k-1].i1+1<spans[k].i0) ))
+        return false;
+  }
+  return true;
+}
+
+
+void test_algebra(const Grid& g)
+{
+  for(int trial=0; trial<200; ++trial)
+  {
+    const int n =check::random(trial<100? 10: 400);
+    const Spans raw_a =random_spans(g,n);
+    const Spans raw_b =random_spans(g,n);
+    const HexSet ha =to_hexset(g,raw_a);
+    const HexSet hb =to_hexset(g,raw_b);
+
+    // Union with nothing normalises a sorted list.
+    const Spans a =span_union(raw_a,Spans());
+    const Spans b =span_union(raw_b,Spans());
+    CHECK( is_normal(a) && is_normal(b) );
+    CHECK( to_hexset(g,a)==ha );
+    CHECK( a==ha.spans() );
+
+    HexSet h_or(ha);  h_or  |= hb;
+    HexSet h_and(ha); h_and &= hb;
+    HexSet h_sub(ha); h_sub -= hb;
+
+    const Spans s_or =span_union(a,b);
+    const Spans s_and =span_intersection(a,b);
+    const Spans s_sub =span_difference(a,b);
+    CHECK( is_normal(s_or) && s_or==h_or.spans() );
+    CHECK( is_normal(s_and) && s_and==h_and.spans() );
+    CHECK( is_normal(s_sub) && s_sub==h_sub.spans() );
+    CHECK( span_union(raw_a,raw_b)==s_or );
+    CHECK( span_union(b,a)==s_or );
+    CHECK( span_intersection(b,a)==s_and );
+    CHECK( span_difference(a,a).empty() );
+    CHECK( span_intersection(a,Spans()).empty() );
+    CHECK( span_difference(a,Spans())==a );
+  }
+}
+
+
+void test_storage(const Grid& g)
+{
+  const Area disc(g.hex(10,10),4);
+  CHECK( disc.storage()==Area::HEXES );
+  CHECK( is_normal(disc.spans()) );
+
+  // Unsorted, overlapping spans are normalised; empty spans are ignored.
+  Spans messy;
+  messy.push_back( Area::Span(3,5,9) );
+  messy.push_back( Area::Span(2,1,4) );
+  messy.push_back( Area::Span(3,2,6) );
+  messy.push_back( Area::Span(2,5,5) );
+  messy.push_back( Area::Span(4,7,3) );
+  const Area m(g,messy);
+  CHECK( m.storage()==Area::SPANS );
+  CHECK( m.size()==13 && m.spans().size()==2 );
+  CHECK( m.spans()[0]==Area::Span(2,1,5) && m.spans()[1]==Area::Span(3,2,9) );
+  CHECK( m.contains(g.hex(9,3)) && !m.contains(g.hex(0,2)) );
+  CHECK( m.hexes().size()==13 );
+  Spans off;
+  off.push_back( Area::Span(0,g.cols()-2,g.cols()) );
+  CHECK_THROWS( Area(g,off), hex::out_of_range );
+
+  // Conversion keeps the hexes, and the svg::Identity, in every direction.
+  Area a(disc);
+  a.id = "disc";
+  a.style = "fill:red";
+  a.className = "round";
+  const Area hexes(a,Area::HEXES);
+  const Area spans(a,Area::SPANS);
+  const Area spans2(spans,Area::SPANS);
+  const Area hexes2(spans,Area::HEXES);
+  const Area* all[] = { &hexes, &spans, &spans2, &hexes2 };
+  for(int k=0; k<4; ++k)
+  {
+    CHECK( all[k]->hexes()==disc.hexes() );
+    CHECK( all[k]->spans()==disc.spans() );
+    CHECK( all[k]->size()==disc.size() );
+    CHECK( all[k]->id=="disc" );
+    CHECK( all[k]->style=="fill:red" );
+    CHECK( all[k]->className=="round" );
+  }
+  CHECK( spans.storage()==Area::SPANS && hexes2.storage()==Area::HEXES );
+  CHECK( Area(Area(),Area::SPANS).size()==0 );
+}
+
+
+int main()
+{
+  Grid g(40,30);
+  test_algebra(g);
+  test_storage(g);
+  return check::report("test_spans");
+}
@@ -0,0 +1,107 @@
+// Behaviour tests for the Spiral and Disc iterators, checked against
+// hex::distance(), including empty and out-of-range radii.
+
+#include "check.h"
+#include "hex.h"
+
+#include <algorithm>
+#include <climits>
+#include <set>
+#include <vector>
+
+using namespace hex;
+
+
+/** Orders hexes by j, then by i. */
+struct RowMajor
+{
+  bool operator()(const Hex* a, const Hex* b) const
+    { return a->j<b->j || (a->j==b->j && a->i<b->i); }
+};
+
+
+/** The hexes from r0 to r1 steps from centre, in row-major order. */
+std::vector<Hex*> reference(const Grid& g, const Hex* centre,
+                            size_t r0, size_t r1)
+{
+  std::vector<Hex*> result;
+  for(int j=0; j<g.rows(); ++j)
+    for(int i=0; i<g.cols(); ++i)
+    {
+      const size_t d =distance(centre,g.hex(i,j));
+      if(r0<=d && d<=r1)
+          result.push_back( g.hex(i,j) );
+    }
+  return result;
+}
+
+
+void check_spiral(const Grid& g, Hex* centre, size_t r0, size_t r1)
+{
+  const Spiral s(centre,r0,r1);
+  std::vector<Hex*> got;
+  size_t last =0;
+  bool ordered =true;
+  for(Spiral::const_iterator h=s.begin(); h!=s.end(); ++h)
+  {
+    got.push_back(*h);
+    const size_t d =distance(centre,*h);
+    ordered = ordered && d>=last && d==h.radius();
+    last = d;
+  }
+  CHECK( ordered ); // Nearest first.
+  std::sort(got.begin(),got.end(),RowMajor());
+  CHECK( std::adjacent_find(got.begin(),got.end())==got.end() );
+  CHECK( got==reference(g,centre,r0,r1) );
+  if(r0>r1)
+      CHECK( s.begin()==s.end() );
+}
+
+
+void check_disc(const Grid& g, Hex* centre, int r)
+{
+  const Disc disc(centre,r);
+  const std::vector<Hex*> got(disc.begin(),disc.end());
+  if(r<0)
+  {
+    CHECK( got.empty() && disc.begin()==disc.end() );
+    CHECK( Area(centre,r).size()==0 );
+    return;
+  }
+  const std::vector<Hex*> expected =reference(g,centre,0,size_t(r));
+  CHECK( got==expected ); // Row by row.
+  const std::set<Hex*> hexes(expected.begin(),expected.end());
+  CHECK( Area(centre,r).hexes()==hexes );
+}
+
+
+int main()
+{
+  Grid g(17,13);
+  const size_t all =size_t(g.cols()*g.rows());
+  Hex* centres[] = { g.hex(8,6), g.hex(0,0), g.hex(16,12), g.hex(3,11),
+                     g.hex(16,1) };
+  for(int c=0; c<5; ++c)
+  {
+    Hex* centre =centres[c];
+    for(size_t r0=0; r0<=9; ++r0)
+        for(size_t r1=0; r1<=9; ++r1)
+            check_spiral(g,centre,r0,r1);
+    for(int r=-3; r<=20; ++r)
+        check_disc(g,centre,r);
+
+    // Empty & huge ranges finish, and do not throw.
+    CHECK( ring(centre,size_t(-1)).begin()==ring(centre,size_t(-1)).end() );
+    CHECK( ring(centre,1000).begin()==ring(centre,1000).end() );
+    const Spiral whole =spiral(centre,size_t(-1));
+    CHECK( size_t(std::distance(whole.begin(),whole.end()))==all );
+    const Spiral none(centre,size_t(-1),5);
+    CHECK( none.begin()==none.end() );
+    check_disc(g,centre,INT_MIN);
+    const Disc huge(centre,INT_MAX);
+    CHECK( size_t(std::distance(huge.begin(),huge.end()))==all );
+    CHECK( Area(centre,INT_MAX).size()==all );
+    CHECK( range(centre,size_t(-1)).empty() );
+  }
+  return check::report("test_spiral");
+}
@@ -0,0 +1,145 @@
+// Behaviour tests for the string encodings of an Area: Area::str() and
+// Grid::area() must round-trip, in both encodings, and reject malformed
+// row spans.
+// Run as "test_str --corpus" to print test cases for test_hexjs.js, which
+// checks that hex.js parses the same strings to the same hexes.
+
+#include "check.h"
+#include "hex.h"
+
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <set>
+#include <string>
+
+using namespace hex;
+
+
+/** Well-formed span strings that Grid::area() must reject. */
+const char* const bad_spans[] = {
+  "3_3=",         // No spans.
+  "3_3=;",
+  "3_3=;;",
+  "3_3=0",        // Odd number of values.
+  "3_3=0,2,1",
+  "3_3=0,0",      // Empty run.
+  "3_3=0,-2",
+  "3_3=0,2,",     // Missing value.
+  "3_3=,2",
+  "3_3=0,,2",
+  "3_3=0,2x",     // Trailing junk.
+  "3_3=0x,2",
+  "3_3=0,2;1,1z",
+  "3_3=0,2.5",
+  "3_3= 0,2",     // White space.
+  "3_3=0, 2",
+  "3_3=0,2 ",
+  "3_3=+0,2",     // Explicit plus.
+  "3_3=0,+2",
+  "3_3=-,2",
+  "3_3=0;2",
+  "3_3=0,2;-1",
+  NULL
+};
+
+
+/** A random connected area: any component of a random set, or the largest.
+ *  (Large areas tend to use the row-span encoding, small ones fill paths.) */
+Area random_area(const Grid& g)
+{
+  HexSet s(g);
+  const int n =1 + check::random(g.cols()*g.rows());
+  for(int k=0; k<n; ++k)
+      s.insert( check::random(g.cols()), check::random(g.rows()) );
+  const std::list<Area> all =areas(s);
+  std::list<Area>::const_iterator a =all.begin();
+  if(check::random(2))
+  {
+    std::advance( a, check::random(int(all.size())) );
+    return *a;
+  }
+  Area result;
+  for(; a!=all.end(); ++a)
+      if(a->size()>result.size())
+          result = *a;
+  return result;
+}
+
+
+/** On a SPARSE grid, the Hexes are not in row order, so the first Hex of
+ *  an area need not be the first hex of its first span. Both encodings must
+ *  still start from the same hex. Areas straddle column 100 and a tile edge
+ *  (column 64), so that their hexes' names differ in length. */
+void test_sparse_origin(void)
+{
+  Grid g(200,150,Grid::SPARSE);
+  for(int trial=0; trial<300; ++trial)
+  {
+    HexSet s(g);
+    const int n =1 + check::random(300);
+    for(int k=0; k<n; ++k)
+        s.insert( 60+check::random(50), 5+check::random(20) );
+    const std::list<Area> all =areas(s);
+    for(std::list<Area>::const_iterator a=all.begin(); a!=all.end(); ++a)
+    {
+      const Area::Span first =a->spans().front();
+      const std::string shortest =a->str();
+      CHECK( g.area(shortest).hexes()==a->hexes() );
+      CHECK( shortest.size()<=a->str(g.hex(first.i0,first.j)).size() );
+      CHECK( shortest.size()<=Area(*a,Area::SPANS).str().size() );
+    }
+  }
+}
+
+
+std::string str(const std::set<Hex*>& hexes)
+{
+  std::string result;
+  for(std::set<Hex*>::const_iterator h=hexes.begin(); h!=hexes.end(); ++h)
+      result += (h==hexes.begin()? "": " ") + (**h).str();
+  return result;
+}
+
+
+int main(int argc, char** argv)
+{
+  const bool corpus =( argc>1 && 0==std::strcmp(argv[1],"--corpus") );
+  Grid g(23,19);
+  if(corpus)
+      std::cout<<g.cols()<<" "<<g.rows()<<"\n";
+  for(int trial=0; trial<300; ++trial)
+  {
+    const Area a =random_area(g);
+    std::set<Hex*>::const_iterator o =a.hexes().begin();
+    std::advance( o, check::random(int(a.size())) );
+    Hex* origin =*o;
+    const std::string shortest =a.str();
+    const std::string fill =a.str(origin);
+    const std::string spans =Area(a,Area::SPANS).str();
+    CHECK( g.area(shortest).hexes()==a.hexes() );
+    CHECK( g.area(fill).hexes()==a.hexes() );
+    CHECK( g.area(spans).hexes()==a.hexes() );
+    CHECK( shortest.size()<=a.str(*a.hexes().begin()).size() );
+    CHECK( fill.find('=')==std::string::npos );
+    if(corpus)
+    {
+      const std::string hexes =str(a.hexes());
+      std::cout<<"="<<shortest<<"\t"<<hexes<<"\n";
+      std::cout<<"="<<fill<<"\t"<<hexes<<"\n";
+    }
+  }
+  for(const char* const* s=bad_spans; *s; ++s)
+  {
+    CHECK_THROWS( g.area(*s), hex::invalid_argument );
+    if(corpus)
+        std::cout<<"!"<<*s<<"\n";
+  }
+  // Spans that run off the grid.
+  CHECK_THROWS( g.area("20_3=0,4"), hex::out_of_range );
+  CHECK_THROWS( g.area("3_3=-4,2"), hex::out_of_range );
+  if(corpus)
+      return check::failures()? 1: 0;
+  test_sparse_origin();
+  return check::report("test_str");
+}